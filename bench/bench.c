@@ -0,0 +1,662 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "cacti.h"
+
+// Microbenchmarks of actor runtime. Every workload runs in its own process,
+// so peak RSS belongs to one run only.
+// Messages sent in benchmarks carry their sending time as data.
+
+#define MSG_PING (message_type_t)0x1
+
+#define MSG_COLLECT (message_type_t)0x1
+#define MSG_TICK (message_type_t)0x1
+
+#define MSG_READY (message_type_t)0x1
+#define MSG_ROUND (message_type_t)0x2
+#define MSG_RECEIVE (message_type_t)0x1
+
+#define MSG_DONE (message_type_t)0x1
+
+#define MSG_TOKEN (message_type_t)0x1
+#define MSG_INJECT (message_type_t)0x2
+
+// Messages sent by producer in one tick.
+#define CHUNK 64
+
+#define DEFAULT_MESSAGES 100000
+#define DEFAULT_ACTORS 16
+
+typedef struct result {
+    bool ok;
+    double seconds;
+    size_t messages;
+    double p50_us;
+    double p99_us;
+    long peak_rss_kb;
+} result_t;
+
+typedef struct workload {
+    const char *name;
+    role_t *role;
+} workload_t;
+
+// Parameters of current run.
+static size_t messages_count = DEFAULT_MESSAGES;
+static size_t actors_count = DEFAULT_ACTORS;
+
+// Latencies in nanoseconds.
+static uint64_t *samples;
+static size_t samples_capacity;
+static atomic_size_t samples_taken;
+
+// Number of messages workload got through the system.
+static atomic_size_t messages_done;
+
+static uint64_t now_ns() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000 + (uint64_t) time.tv_nsec;
+}
+
+static void *stamp() {
+    return (void *) (uintptr_t) now_ns();
+}
+
+static void record(void *data) {
+    uint64_t sent = (uint64_t) (uintptr_t) data;
+    size_t sample = atomic_fetch_add(&samples_taken, 1);
+
+    if (sample < samples_capacity) {
+        samples[sample] = now_ns() - sent;
+    }
+}
+
+static void send(actor_id_t actor, message_type_t type, void *data) {
+    message_t message = {.message_type = type, .data = data};
+    int error_code = send_message_blocking(actor, message);
+    assert(error_code == 0);
+    (void) error_code;
+}
+
+static void spawn(role_t *role) {
+    send(actor_id_self(), MSG_SPAWN, role);
+}
+
+// Two actors bounce one message.
+
+static actor_id_t pingpong_root;
+static actor_id_t pingpong_partner;
+
+static void pingpong_root_hello(void **stateptr, size_t nbytes, void *data);
+
+static void pingpong_partner_hello(void **stateptr, size_t nbytes, void *data);
+
+static void pingpong_ping(void **stateptr, size_t nbytes, void *data);
+
+static role_t pingpong_role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {pingpong_root_hello, pingpong_ping}
+};
+
+static role_t pingpong_partner_role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {pingpong_partner_hello, pingpong_ping}
+};
+
+static void pingpong_root_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    pingpong_root = actor_id_self();
+    spawn(&pingpong_partner_role);
+}
+
+static void pingpong_partner_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    pingpong_partner = actor_id_self();
+    send(pingpong_root, MSG_PING, stamp());
+}
+
+static void pingpong_ping(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    record(data);
+
+    actor_id_t other = actor_id_self() == pingpong_root ? pingpong_partner
+                                                        : pingpong_root;
+
+    if (atomic_fetch_add(&messages_done, 1) + 1 < messages_count) {
+        send(other, MSG_PING, stamp());
+    }
+    else {
+        send(other, MSG_GODIE, NULL);
+        send(actor_id_self(), MSG_GODIE, NULL);
+    }
+}
+
+// Many producers send to one actor.
+
+typedef struct producer {
+    actor_id_t sink;
+    size_t sent;
+} producer_t;
+
+static void fanin_hello(void **stateptr, size_t nbytes, void *data);
+
+static void fanin_collect(void **stateptr, size_t nbytes, void *data);
+
+static void fanin_producer_hello(void **stateptr, size_t nbytes, void *data);
+
+static void fanin_tick(void **stateptr, size_t nbytes, void *data);
+
+static role_t fanin_role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {fanin_hello, fanin_collect}
+};
+
+static role_t fanin_producer_role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {fanin_producer_hello, fanin_tick}
+};
+
+static void fanin_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    for (size_t producer = 0; producer < actors_count; ++producer) {
+        spawn(&fanin_producer_role);
+    }
+}
+
+static void fanin_collect(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    record(data);
+
+    size_t total = messages_count / actors_count * actors_count;
+    if (atomic_fetch_add(&messages_done, 1) + 1 == total) {
+        send(actor_id_self(), MSG_GODIE, NULL);
+    }
+}
+
+static void fanin_producer_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    producer_t *producer = (producer_t *) malloc(sizeof(producer_t));
+    producer->sink = (actor_id_t) data;
+    producer->sent = 0;
+    *stateptr = producer;
+
+    send(actor_id_self(), MSG_TICK, NULL);
+}
+
+static void fanin_tick(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    (void) data;
+    producer_t *producer = (producer_t *) *stateptr;
+    size_t quota = messages_count / actors_count;
+
+    for (int i = 0; i < CHUNK && producer->sent < quota; ++i) {
+        send(producer->sink, MSG_COLLECT, stamp());
+        producer->sent++;
+    }
+
+    if (producer->sent < quota) {
+        send(actor_id_self(), MSG_TICK, NULL);
+    }
+    else {
+        free(producer);
+        send(actor_id_self(), MSG_GODIE, NULL);
+    }
+}
+
+// One actor broadcasts rounds to many actors.
+
+static actor_id_t *fanout_members;
+static size_t fanout_ready;
+static size_t fanout_rounds;
+
+static void fanout_hello(void **stateptr, size_t nbytes, void *data);
+
+static void fanout_ready_member(void **stateptr, size_t nbytes, void *data);
+
+static void fanout_round(void **stateptr, size_t nbytes, void *data);
+
+static void fanout_member_hello(void **stateptr, size_t nbytes, void *data);
+
+static void fanout_receive(void **stateptr, size_t nbytes, void *data);
+
+static role_t fanout_role = {
+        .nprompts = 3,
+        .prompts = (act_t[]) {fanout_hello, fanout_ready_member, fanout_round}
+};
+
+static role_t fanout_member_role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {fanout_member_hello, fanout_receive}
+};
+
+static void fanout_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    fanout_members = (actor_id_t *) malloc(actors_count * sizeof(actor_id_t));
+    fanout_ready = 0;
+    fanout_rounds = 0;
+
+    for (size_t member = 0; member < actors_count; ++member) {
+        spawn(&fanout_member_role);
+    }
+}
+
+static void fanout_ready_member(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    fanout_members[fanout_ready++] = (actor_id_t) data;
+
+    if (fanout_ready == actors_count) {
+        send(actor_id_self(), MSG_ROUND, NULL);
+    }
+}
+
+static void fanout_round(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    // Members are sent one by one, as send_group skips full mailboxes
+    // and every run has to deliver the same number of messages.
+    void *sent = stamp();
+    for (size_t member = 0; member < actors_count; ++member) {
+        send(fanout_members[member], MSG_RECEIVE, sent);
+    }
+
+    if (++fanout_rounds < messages_count / actors_count) {
+        send(actor_id_self(), MSG_ROUND, NULL);
+        return;
+    }
+
+    for (size_t member = 0; member < actors_count; ++member) {
+        send(fanout_members[member], MSG_GODIE, NULL);
+    }
+    free(fanout_members);
+    send(actor_id_self(), MSG_GODIE, NULL);
+}
+
+static void fanout_member_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    actor_id_t parent = (actor_id_t) data;
+
+    send(parent, MSG_READY, (void *) actor_id_self());
+}
+
+static void fanout_receive(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    record(data);
+    atomic_fetch_add(&messages_done, 1);
+}
+
+// One actor spawns many short living ones.
+
+static actor_id_t storm_parent;
+static size_t storm_done;
+
+static void storm_hello(void **stateptr, size_t nbytes, void *data);
+
+static void storm_done_child(void **stateptr, size_t nbytes, void *data);
+
+static void storm_child_hello(void **stateptr, size_t nbytes, void *data);
+
+static role_t storm_role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {storm_hello, storm_done_child}
+};
+
+static role_t storm_child_role = {
+        .nprompts = 1,
+        .prompts = (act_t[]) {storm_child_hello}
+};
+
+static void storm_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    storm_parent = actor_id_self();
+    storm_done = 0;
+
+    // Every child gets time of its own spawn in hello.
+    for (size_t child = 0; child < messages_count; ++child) {
+        void *spawned_at = stamp();
+        long spawned = spawn_actors(&storm_child_role, 1, &spawned_at, NULL);
+        assert(spawned == 1);
+        (void) spawned;
+    }
+}
+
+static void storm_done_child(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    atomic_fetch_add(&messages_done, 1);
+
+    if (++storm_done == messages_count) {
+        send(actor_id_self(), MSG_GODIE, NULL);
+    }
+}
+
+// Latency is time from child's spawn to its hello.
+static void storm_child_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    record(data);
+    send(storm_parent, MSG_DONE, NULL);
+    send(actor_id_self(), MSG_GODIE, NULL);
+}
+
+// Tokens travel through long chain of actors, like sums in macierz.
+
+typedef struct link {
+    actor_id_t parent;
+    size_t forwarded;
+} link_t;
+
+static atomic_size_t chain_length;
+
+static void chain_token_root(void **stateptr, size_t nbytes, void *data);
+
+static void chain_link_hello(void **stateptr, size_t nbytes, void *data);
+
+static void chain_token(void **stateptr, size_t nbytes, void *data);
+
+static void chain_inject(void **stateptr, size_t nbytes, void *data);
+
+static void chain_hello(void **stateptr, size_t nbytes, void *data);
+
+static role_t chain_role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {chain_hello, chain_token_root}
+};
+
+static role_t chain_link_role = {
+        .nprompts = 3,
+        .prompts = (act_t[]) {chain_link_hello, chain_token, chain_inject}
+};
+
+static void chain_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    atomic_store(&chain_length, 0);
+    spawn(&chain_link_role);
+}
+
+static void chain_token_root(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    record(data);
+
+    if (atomic_fetch_add(&messages_done, 1) + 1 == messages_count) {
+        send(actor_id_self(), MSG_GODIE, NULL);
+    }
+}
+
+// Last link injects tokens, others forward them towards root.
+static void chain_link_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    link_t *link = (link_t *) malloc(sizeof(link_t));
+    link->parent = (actor_id_t) data;
+    link->forwarded = 0;
+    *stateptr = link;
+
+    if (atomic_fetch_add(&chain_length, 1) + 1 < actors_count) {
+        spawn(&chain_link_role);
+    }
+    else {
+        send(actor_id_self(), MSG_INJECT, NULL);
+    }
+}
+
+static void chain_token(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    link_t *link = (link_t *) *stateptr;
+
+    send(link->parent, MSG_TOKEN, data);
+
+    if (++link->forwarded == messages_count) {
+        free(link);
+        send(actor_id_self(), MSG_GODIE, NULL);
+    }
+}
+
+static void chain_inject(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    (void) data;
+    link_t *link = (link_t *) *stateptr;
+
+    for (int i = 0; i < CHUNK && link->forwarded < messages_count; ++i) {
+        send(link->parent, MSG_TOKEN, stamp());
+        link->forwarded++;
+    }
+
+    if (link->forwarded < messages_count) {
+        send(actor_id_self(), MSG_INJECT, NULL);
+    }
+    else {
+        free(link);
+        send(actor_id_self(), MSG_GODIE, NULL);
+    }
+}
+
+static const workload_t workloads[] = {
+        {"pingpong", &pingpong_role},
+        {"fanin", &fanin_role},
+        {"fanout", &fanout_role},
+        {"spawn", &storm_role},
+        {"chain", &chain_role},
+};
+
+static int compare_samples(const void *a, const void *b) {
+    uint64_t first = *(const uint64_t *) a;
+    uint64_t second = *(const uint64_t *) b;
+    return (first > second) - (first < second);
+}
+
+static double percentile(size_t count, double fraction) {
+    if (count == 0) {
+        return 0;
+    }
+
+    size_t sample = (size_t) (fraction * (double) (count - 1));
+    return (double) samples[sample] / 1000;
+}
+
+// Runs workload in current process.
+static result_t run(const workload_t *workload, size_t threads) {
+    result_t result = {.ok = true};
+
+    samples_capacity = messages_count;
+    samples = (uint64_t *) malloc(samples_capacity * sizeof(uint64_t));
+    atomic_store(&samples_taken, 0);
+    atomic_store(&messages_done, 0);
+
+    // Handlers may park all messages of workload for one actor.
+    cacti_config_t config = {
+            .threads = threads,
+            .parked_limit = messages_count
+    };
+    actor_id_t root;
+
+    uint64_t start = now_ns();
+    if (actor_system_create_ex(&root, workload->role, &config) != 0) {
+        result.ok = false;
+        return result;
+    }
+    actor_system_join(root);
+    uint64_t end = now_ns();
+
+    size_t taken = atomic_load(&samples_taken);
+    if (taken > samples_capacity) {
+        taken = samples_capacity;
+    }
+    qsort(samples, taken, sizeof(uint64_t), compare_samples);
+
+    // Chain counts every hop.
+    result.messages = atomic_load(&messages_done);
+    if (workload->role == &chain_role) {
+        result.messages *= actors_count;
+    }
+    result.seconds = (double) (end - start) / 1e9;
+    result.p50_us = percentile(taken, 0.5);
+    result.p99_us = percentile(taken, 0.99);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result.peak_rss_kb = usage.ru_maxrss;
+
+    free(samples);
+    return result;
+}
+
+// Runs workload in child process, so each run starts with fresh system.
+static result_t run_forked(const workload_t *workload, size_t threads) {
+    result_t result = {.ok = false};
+    int pipe_ends[2];
+
+    if (pipe(pipe_ends) != 0) {
+        return result;
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        close(pipe_ends[0]);
+        result = run(workload, threads);
+        ssize_t written = write(pipe_ends[1], &result, sizeof(result_t));
+        _exit(written == sizeof(result_t) ? 0 : 1);
+    }
+
+    close(pipe_ends[1]);
+    if (child > 0) {
+        if (read(pipe_ends[0], &result, sizeof(result_t))
+            != sizeof(result_t)) {
+            result.ok = false;
+        }
+        waitpid(child, NULL, 0);
+    }
+    close(pipe_ends[0]);
+
+    return result;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-t threads,...] [-n messages] [-a actors]"
+            " [-w workload] [-f csv|json]\n"
+            "workloads: pingpong fanin fanout spawn chain\n",
+            program);
+}
+
+int main(int argc, char *argv[]) {
+    char threads_list[256] = "1,2,4";
+    const char *only = NULL;
+    bool json = false;
+
+    int option;
+    while ((option = getopt(argc, argv, "t:n:a:w:f:h")) != -1) {
+        switch (option) {
+            case 't':
+                snprintf(threads_list, sizeof(threads_list), "%s", optarg);
+                break;
+            case 'n':
+                messages_count = strtoul(optarg, NULL, 10);
+                break;
+            case 'a':
+                actors_count = strtoul(optarg, NULL, 10);
+                break;
+            case 'w':
+                only = optarg;
+                break;
+            case 'f':
+                json = strcmp(optarg, "json") == 0;
+                break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+
+    if (messages_count < actors_count || actors_count == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (json) {
+        printf("[");
+    }
+    else {
+        printf("workload,threads,messages,seconds,messages_per_second,"
+               "p50_us,p99_us,peak_rss_kb\n");
+    }
+
+    bool first = true;
+    size_t workloads_count = sizeof(workloads) / sizeof(workload_t);
+
+    for (size_t w = 0; w < workloads_count; ++w) {
+        const workload_t *workload = &workloads[w];
+        if (only != NULL && strcmp(only, workload->name) != 0) {
+            continue;
+        }
+
+        char list[256];
+        snprintf(list, sizeof(list), "%s", threads_list);
+
+        for (char *token = strtok(list, ","); token != NULL;
+             token = strtok(NULL, ",")) {
+            size_t threads = strtoul(token, NULL, 10);
+            result_t result = run_forked(workload, threads);
+
+            if (!result.ok) {
+                fprintf(stderr, "%s with %zu threads failed\n",
+                        workload->name, threads);
+                continue;
+            }
+
+            double rate = result.seconds > 0
+                          ? (double) result.messages / result.seconds : 0;
+
+            if (json) {
+                printf("%s\n  {\"workload\": \"%s\", \"threads\": %zu, "
+                       "\"messages\": %zu, \"seconds\": %.6f, "
+                       "\"messages_per_second\": %.0f, \"p50_us\": %.3f, "
+                       "\"p99_us\": %.3f, \"peak_rss_kb\": %ld}",
+                       first ? "" : ",", workload->name, threads,
+                       result.messages, result.seconds, rate, result.p50_us,
+                       result.p99_us, result.peak_rss_kb);
+            }
+            else {
+                printf("%s,%zu,%zu,%.6f,%.0f,%.3f,%.3f,%ld\n",
+                       workload->name, threads, result.messages,
+                       result.seconds, rate, result.p50_us, result.p99_us,
+                       result.peak_rss_kb);
+            }
+            fflush(stdout);
+            first = false;
+        }
+    }
+
+    if (json) {
+        printf("\n]\n");
+    }
+
+    return 0;
+}
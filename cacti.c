@@ -1,495 +1,3863 @@
+// Needed for thread affinity.
+#define _GNU_SOURCE
+
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include "cacti.h"
 
-
-// Cyclic queue of actors' events.
-typedef struct cyclic_queue {
-    size_t first_empty;
-    size_t first_full;
-    size_t current_size;
-
-    message_t *messages[ACTOR_QUEUE_LIMIT];
-} cyclic_queue_t;
+// Timer wheel has TIMER_LEVELS levels of TIMER_SLOTS slots,
+// one tick lasts TIMER_TICK_US microseconds.
+#define TIMER_BITS 6
+#define TIMER_SLOTS (1 << TIMER_BITS)
+#define TIMER_LEVELS 4
+#define TIMER_TICK_US 1000
+#define TIMER_NEVER ULLONG_MAX
+
+// Values of worker's futex word.
+#define WORKER_AWAKE 0
+#define WORKER_PARKED 1
+
+// Time after which idle thread of blocking pool ends.
+#define BLOCKING_IDLE_US 1000000
+
+// Single slot of actor's mailbox.
+// Sequence tells whether slot is ready for producer or for consumer.
+typedef struct mailbox_slot {
+    atomic_size_t sequence;
+    message_t message;
+} mailbox_slot_t;
+
+// Ring of mailbox slots. Producers reserve slots with CAS on
+// enqueue_position, only thread owning actor reads dequeue_position.
+// When ring is full or idle it is closed and producers move on
+// to next segment, which is sized to current number of messages.
+typedef struct mailbox_segment {
+    atomic_size_t enqueue_position;
+    size_t dequeue_position;
+
+    _Atomic(struct mailbox_segment *) next;
+
+    // List of segments waiting until no producer can access them.
+    struct mailbox_segment *retired;
+
+    size_t capacity;
+    mailbox_slot_t slots[];
+} mailbox_segment_t;
+
+// Lock-free multi-producer single-consumer queue of actor's events.
+// Messages are stored by value, so sending does not allocate
+// unless mailbox has to grow.
+// Starts with shared empty closed segment, so idle actor holds no slots
+// at all.
+typedef struct mailbox {
+    // Number of accepted and not yet performed messages.
+    atomic_size_t size;
+
+    // Number of producers which may be using segments right now.
+    atomic_size_t producers;
+
+    // Biggest size mailbox has ever reached.
+    atomic_size_t high_water;
+
+    _Atomic(mailbox_segment_t *) tail;
+
+    // Ring which followed shared closed segment, it plays the role of its
+    // next. Cleared once no producer can find closed segment in tail.
+    _Atomic(mailbox_segment_t *) first;
+
+    // Owned by thread performing actor.
+    mailbox_segment_t *head;
+    mailbox_segment_t *retired;
+} mailbox_t;
+
+struct cacti_buf {
+    atomic_size_t references;
+    size_t nbytes;
+    _Alignas(max_align_t) unsigned char data[];
+};
+
+// Message sent from handler to full mailbox, waiting there for space.
+typedef struct parked_message {
+    message_t message;
+    struct parked_message *next;
+} parked_message_t;
 
 // Actor's necessary data.
 typedef struct actor {
     actor_id_t id;
-    bool is_dead;
-    bool in_queue;
-    cyclic_queue_t *messages_queue;
     role_t *role;
     void *state;
+    mailbox_t mailbox;
+
+    // Lane of high priority messages, drained before mailbox.
+    // Created by first such message, most actors never get one.
+    _Atomic(struct mailbox *) urgent;
+
+    // Pool thread which performed actor last, NO_HOME if none yet.
+    // Actor is scheduled back to it, so its state stays in that cache.
+    atomic_size_t home;
+
+    // Next actor in inbox of home thread.
+    struct actor *inbox_next;
+
+    // Parked messages in order of sending, list is used under mutex.
+    atomic_size_t parked;
+    parked_message_t *parked_first;
+    parked_message_t *parked_last;
+
+    // Statistics, written only by thread owning actor.
+    atomic_size_t handled;
+    atomic_size_t send_failures;
+
+    // Actors of high priority are scheduled on urgent_queue.
+    atomic_int priority;
+
+    // Urgent messages performed in a row, used only by owner.
+    unsigned urgent_streak;
+
+    atomic_bool is_dead;
+    atomic_bool in_queue;
 } actor_t;
 
-// Queue of actors waiting for free thread.
+// Entry of actors registry. Entries live as long as system does,
+// so senders can look at them even if actor was just reclaimed.
+typedef struct actor_slot {
+    _Atomic(actor_t *) actor;
+
+    // Generation of current actor or of next one if slot is free.
+    atomic_long generation;
+
+    // Number of threads sending to this slot right now.
+    atomic_size_t senders;
+
+    // Number of threads waiting for space in actor's mailbox.
+    atomic_size_t space_waiters;
+
+    // Next free slot, used under mutex.
+    size_t next_free;
+} actor_slot_t;
+
+// Queue of actors made runnable by threads outside of the pool.
+// Grows twice when full.
 typedef struct actor_queue {
     size_t first_empty;
     size_t first_full;
-    size_t current_size;
+    atomic_size_t current_size;
 
-    actor_id_t actors[CAST_LIMIT];
+    size_t capacity;
+    actor_id_t *actors;
 } actor_queue_t;
 
+// Circular array of work-stealing deque.
+// Replaced by twice bigger one when full, old ones are kept
+// in previous list until system is destroyed as thieves may still read them.
+typedef struct deque_array {
+    long capacity;
+    struct deque_array *previous;
+    atomic_long actors[];
+} deque_array_t;
+
+// Kinds of traced scheduling events.
+typedef enum trace_type {
+    TRACE_SPAWN,
+    TRACE_ENQUEUE,
+    TRACE_DEQUEUE,
+    TRACE_HANDLER_BEGIN,
+    TRACE_HANDLER_END,
+    TRACE_GODIE,
+    TRACE_SLEEP_BEGIN,
+    TRACE_SLEEP_END
+} trace_type_t;
+
+typedef struct trace_event {
+    unsigned long long time;
+    trace_type_t type;
+    actor_id_t actor;
+    message_type_t message_type;
+} trace_event_t;
+
+// Ring of latest events of one thread, oldest are overwritten.
+typedef struct trace_ring {
+    atomic_size_t position;
+    size_t capacity;
+    trace_event_t *events;
+} trace_ring_t;
+
+struct actors_system;
+
+// Pool thread with its Chase-Lev deque of runnable actors.
+// Only owner pushes and takes from bottom, other threads steal from top.
+typedef struct worker {
+    _Alignas(64) atomic_long top;
+    _Alignas(64) atomic_long bottom;
+    _Atomic(deque_array_t *) array;
+
+    size_t index;
+    pthread_t thread;
+    struct actors_system *system;
+
+    // CPU thread is pinned to, -1 if it is not pinned.
+    int cpu;
+
+    // NUMA node thread started on. Thread allocates its deque and trace
+    // itself, so their pages are placed on this node on first touch.
+    int node;
+
+    // Number of searches for actor, used to poll actors_queue from time to time.
+    size_t searches;
+
+    // Number of times actor was taken and number of messages performed.
+    atomic_size_t dispatches;
+    atomic_size_t dispatched_messages;
+
+    // Nanoseconds spent sleeping for actors and waiting for mutex.
+    atomic_ullong idle_ns;
+    atomic_ullong lock_wait_ns;
+
+    // Events of this thread, used only if tracing is on.
+    trace_ring_t trace;
+
+    // Actors made runnable by other threads whose home is this thread,
+    // latest first. Owner moves them to its deque, other threads steal
+    // them once inbox has been waiting since inbox_since for too long.
+    _Atomic(actor_t *) inbox;
+    atomic_ullong inbox_since;
+
+    // Number of actors in inbox, counted before they are pushed.
+    atomic_size_t inbox_size;
+
+    // Set while thread performs actor. Inbox of idle thread is left to it.
+    atomic_bool busy;
+
+    // Drained rings of smallest capacity, linked by retired.
+    // Only owner takes and puts them.
+    mailbox_segment_t *spare_rings;
+    size_t spare_count;
+
+    // Futex word, WORKER_PARKED while thread sleeps waiting for actor.
+    // Waker swaps it back to WORKER_AWAKE before waking thread.
+    atomic_uint parked;
+} worker_t;
+
+// Array of group members. Members join at its end and leave by leaving
+// NO_MEMBER in their place, so senders can walk it without locking.
+// Replaced by compacted copy when full or mostly empty.
+typedef struct group_members {
+    size_t capacity;
+    atomic_size_t count;
+
+    // Number of entries set to NO_MEMBER.
+    atomic_size_t removed;
+
+    // List of arrays waiting until no sender can read them.
+    struct group_members *retired;
+
+    atomic_long actors[];
+} group_members_t;
+
+// Named set of actors receiving messages sent to group.
+typedef struct group {
+    char *name;
+
+    // Mutex for joining and leaving, senders do not take it.
+    pthread_mutex_t mutex;
+
+    _Atomic(group_members_t *) members;
+    group_members_t *retired;
+
+    // Number of threads sending to group right now.
+    atomic_size_t senders;
+} group_t;
+
+// Elastic pool of threads performing actors whose next message
+// is blocking. Threads are started when all are busy, up to limit,
+// and end after idling for BLOCKING_IDLE_US.
+typedef struct blocking_pool {
+    pthread_mutex_t mutex;
+    pthread_cond_t wait_for_actor;
+    pthread_cond_t all_done;
+
+    // Actors handed over by pool threads, still owned (in_queue is set).
+    actor_queue_t queue;
+
+    size_t threads;
+    size_t idle;
+    size_t limit;
+    bool stop;
+} blocking_pool_t;
+
+// Message waiting in timer wheel. Periodic ones are put back after sending.
+typedef struct pending_timer {
+    // Ticks of timer wheel.
+    unsigned long long expires;
+    unsigned long long period;
+
+    actor_id_t actor;
+    message_t message;
+    struct pending_timer *next;
+} pending_timer_t;
+
+typedef struct timer_list {
+    pending_timer_t *first;
+    pending_timer_t *last;
+} timer_list_t;
+
+// Hierarchical timer wheel served by its own thread.
+// Level 0 holds timers expiring in next TIMER_SLOTS ticks, each higher
+// level covers TIMER_SLOTS times longer span and is cascaded down
+// when lower level wraps around, so adding timer costs O(1).
+typedef struct timer_wheel {
+    pthread_mutex_t mutex;
+    pthread_cond_t wakeup;
+    pthread_t thread;
+    bool stop;
+
+    // Number of timers in slots.
+    size_t pending;
+
+    // Time of tick 0 and tick which is served next.
+    unsigned long long start;
+    unsigned long long current;
+
+    // Tick timer thread sleeps until, TIMER_NEVER if it waits for timers.
+    unsigned long long sleeping_until;
+
+    timer_list_t slots[TIMER_LEVELS][TIMER_SLOTS];
+} timer_wheel_t;
+
 // Data structure containing all information about actors.
 typedef struct actors_system {
     // Mutex for working with actors_system.
     pthread_mutex_t mutex;
 
-    // Conditional for waiting for actors.
-    pthread_cond_t wait_for_actor;
+    // Conditional for senders waiting for space in mailboxes.
+    pthread_cond_t wait_for_space;
+
+    // Number of threads parked waiting for actor.
+    atomic_size_t waiting_for_actor;
 
-    // Number of threads waiting for actor.
-    size_t waiting_for_actor;
+    // Pool threads and thread creating system wait on it
+    // until threads are placed and have allocated their memory.
+    pthread_barrier_t workers_ready;
 
-    // Cyclic queue for threads of actors' ids.
+    // Events kept per thread if tracing is on.
+    size_t trace_events;
+
+    // Idle thread searches for actor this many times, then yields
+    // this many times before parking.
+    size_t idle_spins;
+    size_t idle_yields;
+
+    // Time actors wait in inbox of home thread before others take them.
+    unsigned long long inbox_patience_ns;
+
+    // Cyclic queue of actors scheduled from outside of the pool.
     actor_queue_t *actors_queue;
 
-    // Id of next actor.
-    size_t first_empty;
+    // Cyclic queue of high priority actors and actors with urgent
+    // messages, searched before any other queue.
+    actor_queue_t *urgent_queue;
+
+    // Index of first never used slot. Published after slot is written.
+    atomic_size_t first_empty;
+
+    // First slot freed by reclaimed actor, NO_FREE_SLOT if none.
+    size_t free_slots;
+
+    // All actors in system, in chunks of ACTOR_CHUNK_SIZE slots
+    // allocated when first needed.
+    _Atomic(actor_slot_t *) *actors_data;
+
+    // Pool threads with their deques.
+    worker_t *workers;
 
-    // All actors in system.
-    actor_t *actors_data[CAST_LIMIT];
+    // Delayed and periodic messages.
+    timer_wheel_t *timers;
 
-    // Array of threads.
-    pthread_t threads[POOL_SIZE];
+    // Threads for blocking handlers.
+    blocking_pool_t *blocking;
+
+    // Groups of actors, GROUP_LIMIT entries. Created under mutex.
+    _Atomic(group_t *) *groups;
+    size_t groups_count;
+
+    // Limits given in configuration.
+    size_t pool_size;
+    size_t mailbox_limit;
+    size_t parked_limit;
+    size_t cast_limit;
+    size_t batch;
 
     // Number of living actors.
-    size_t living_actors;
+    atomic_size_t living_actors;
+
+    // Number of messages in actors' mailboxes or being performed.
+    atomic_size_t messages_in_system;
+
+    // Number of messages which could not be sent.
+    atomic_size_t send_failures;
 
-    // Number of messages in actors' queues.
-    size_t messages_in_system;
+    // If scheduling events are recorded. Events of threads outside
+    // of the pool share one ring. Trace is written to trace_path
+    // when system is destroyed, unless it is NULL.
+    bool tracing;
+    trace_ring_t trace_external;
+    unsigned long long trace_start;
+    char *trace_path;
 
     // If SIGINT was sent.
-    bool got_sigint;
+    atomic_bool got_sigint;
 
     // Number of threads which joined main thread.
     size_t thread_collected;
 } actors_system_t;
 
 
-// Global data structure maintaining actors.
-static actors_system_t *actors_pool = NULL;
+// Thread state kept aside while thread works with other system.
+typedef struct system_scope {
+    actors_system_t *system;
+    bool chosen;
+    worker_t *worker;
+    actor_t *actor;
+    actor_id_t actor_id;
+} system_scope_t;
+
+// System of actor_system_create, used by threads which chose no other.
+static actors_system_t *default_system = NULL;
+
+// Living systems, SIGINT is delivered to all of them.
+static _Atomic(actors_system_t *) systems[SYSTEM_LIMIT];
+
+// System current thread works with. Threads of the runtime are bound
+// to their system, other threads follow default_system unless they
+// chose another one.
+static __thread actors_system_t *actors_pool = NULL;
+static __thread bool system_chosen = false;
 
 // Thread local variable of current actor being processed.
 static __thread actor_id_t thread_actor_id = -1;
 
+// Thread local variable of current actor's data, NULL outside of handlers.
+static __thread actor_t *thread_actor = NULL;
+
+// Thread local variable of pool thread's worker, NULL outside of the pool.
+static __thread worker_t *thread_worker = NULL;
+
+// Results of deque operations that did not return an actor.
+#define DEQUE_EMPTY (actor_id_t)-1
+#define DEQUE_ABORT (actor_id_t)-2
+
+#define DEQUE_INITIAL_CAPACITY 64
+
+// Actor's id is its slot index tagged with slot's generation,
+// so ids of reclaimed actors never reach actors reusing their slots.
+#define ACTOR_INDEX_BITS 32
+#define ACTOR_INDEX_MASK (((actor_id_t) 1 << ACTOR_INDEX_BITS) - 1)
+#define ACTOR_GENERATION_MASK ((actor_id_t) 0x7fffffff)
+
+#define ACTOR_INDEX(id) ((size_t) ((id) & ACTOR_INDEX_MASK))
+#define ACTOR_GENERATION(id) ((id) >> ACTOR_INDEX_BITS)
+#define ACTOR_ID(generation, index) \
+        (((actor_id_t) (generation) << ACTOR_INDEX_BITS) | (actor_id_t) (index))
+
+#define NO_FREE_SLOT SIZE_MAX
+
+#define NO_HOME SIZE_MAX
+
+// Result of pushing message to full mailbox, reported as -1 to users.
+#define SEND_FULL -3
+
+#define ACTOR_CHUNK_SIZE 1024
+
+#define ACTOR_QUEUE_INITIAL_CAPACITY 64
+
+// Smallest ring of mailbox.
+#define MAILBOX_MIN_CAPACITY 4
+
+// Drained smallest rings kept by pool thread for next idle actor woken up.
+#define SPARE_RINGS 64
+
+// Bit of enqueue_position marking segment which takes no more messages.
+#define SEGMENT_CLOSED ((size_t) 1 << (sizeof(size_t) * 8 - 1))
+
+// Empty closed segment of mailboxes without ring. It is never written,
+// mailbox's first points to ring following it, so all mailboxes share it.
+static mailbox_segment_t closed_segment = {
+        .enqueue_position = SEGMENT_CLOSED,
+        .capacity = 0
+};
+
+// Smallest array of group members.
+#define GROUP_MIN_CAPACITY 16
+
+// Entry of group members left by actor which left group or died.
+#define NO_MEMBER (actor_id_t)-1
+
+// Records event if tracing is on, costs one branch otherwise.
+#define TRACE(type, actor, message_type) \
+        do { \
+            if (actors_pool->tracing) { \
+                trace_event((type), (actor), (message_type)); \
+            } \
+        } while (0)
+
+// How often thread checks actors_queue before its own deque,
+// so actors scheduled from outside of the pool are not starved.
+#define GLOBAL_QUEUE_INTERVAL 61
+
+static actors_system_t *current_system();
+
+static void enter_system(actors_system_t *system, system_scope_t *scope);
+
+static void leave_system(const system_scope_t *scope);
+
+static bool register_system(actors_system_t *system);
+
+static void unregister_system(actors_system_t *system);
+
 static void handle_sigint(int sig);
 
 static void set_sigint_handler();
 
-static message_t *copy_message(message_t message);
-
 static bool thread_keep_working();
 
 static void lock_mutex();
 
 static void unlock_mutex();
 
-static void signal_wait_for_actor();
+static unsigned long long monotonic_ns();
 
-static message_t *get_message(cyclic_queue_t *queue);
+static void count_send_failures(size_t count);
 
-static void add_message(actor_id_t actor_id, cyclic_queue_t *queue,
-                        message_t *message);
+static void trace_ring_init(trace_ring_t *ring, size_t capacity);
 
-static void queue_add_actor(actor_queue_t *queue, actor_id_t actor);
+static void trace_event(trace_type_t type, actor_id_t actor,
+                        message_type_t message_type);
 
-static actor_id_t queue_get_actor(actor_queue_t *queue);
+static void trace_write_ring(FILE *file, trace_ring_t *ring, size_t thread,
+                             bool *first);
 
-static void init_actors_system();
+static int trace_write(const char *path);
 
-static void destroy_actors_system();
+static void futex_wait(atomic_uint *word, unsigned value);
 
-static void add_actor(actor_id_t *actor_id, role_t *const role);
+static void futex_wake(atomic_uint *word);
 
-static void clear_actor(actor_t *actor);
+static bool unpark_worker(worker_t *worker);
 
-void perform_message(actor_t *current_actor, message_t *message);
+static void wake_all_workers();
 
-static void *thread_loop(void *d);
+static void cpu_relax();
 
+static void messages_done(size_t count);
 
-static void handle_sigint(int sig) {
-    if (sig == SIGINT) {
-        actors_pool->got_sigint = true;
-    }
-}
+static void message_retain(const message_t *message);
 
-static void set_sigint_handler() {
-    signal(SIGINT, handle_sigint);
-}
+static void message_release(const message_t *message);
 
-static message_t *copy_message(message_t message) {
-    message_t *copied = (message_t *) malloc(sizeof(message));
-    *copied = message;
+static void mailbox_init(mailbox_t *mailbox);
 
-    return copied;
-}
+static mailbox_segment_t *segment_create(size_t messages);
 
-static bool thread_keep_working() {
-    if (!actors_pool->got_sigint) {
-        return actors_pool->living_actors > 0 || actors_pool->messages_in_system > 0;
-    }
-    else {
-        return actors_pool->messages_in_system > 0;
-    }
-}
+static void segment_free(mailbox_segment_t *segment);
 
-static void lock_mutex() {
-    int error_code = pthread_mutex_lock(&actors_pool->mutex);
-    assert(error_code == 0);
-}
+static void segment_append(mailbox_t *mailbox, mailbox_segment_t *segment);
 
-static void unlock_mutex() {
-    int error_code = pthread_mutex_unlock(&actors_pool->mutex);
-    assert(error_code == 0);
-}
+static void mailbox_reclaim(mailbox_t *mailbox);
 
-static void signal_wait_for_actor() {
-    int error_code = pthread_cond_signal(&actors_pool->wait_for_actor);
-    assert(error_code == 0);
-}
+static void segment_retire(mailbox_t *mailbox, mailbox_segment_t *segment,
+                           mailbox_segment_t *next);
 
-// Returns pointer to message that was first in actor's event queue.
-static message_t *get_message(cyclic_queue_t *queue) {
-    if (queue->current_size == 0) {
-        // Current queue is empty.
-        assert(false);
-    }
+static mailbox_slot_t *mailbox_front(mailbox_t *mailbox);
 
-    queue->current_size--;
+static bool get_message(mailbox_t *mailbox, message_t *message);
 
-    message_t *result = queue->messages[queue->first_full];
-    queue->messages[queue->first_full] = NULL;
-    queue->first_full = (queue->first_full + 1) % ACTOR_QUEUE_LIMIT;
+static size_t segment_add_messages(mailbox_segment_t *segment,
+                                   const message_t *messages, size_t count);
 
-    return result;
-}
+static size_t add_messages(mailbox_t *mailbox, const message_t *messages,
+                           size_t count);
 
-// Adds new_message to actor's event queue.
-static void add_message(actor_id_t actor_id, cyclic_queue_t *queue,
-                        message_t *message) {
-    if (queue->current_size == ACTOR_QUEUE_LIMIT) {
-        assert(false);
-    }
+static bool add_message(mailbox_t *mailbox, const message_t *message);
 
-    queue->current_size++;
+static bool mailbox_empty(mailbox_t *mailbox);
 
-    queue->messages[queue->first_empty] = message;
-    queue->first_empty = (queue->first_empty + 1) % ACTOR_QUEUE_LIMIT;
+static void mailbox_shrink(mailbox_t *mailbox);
 
-    actors_pool->messages_in_system++;
+static void mailbox_destroy(mailbox_t *mailbox);
 
-    // Adds actor to actors queue if its not already added.
-    queue_add_actor(actors_pool->actors_queue, actor_id);
-}
+static mailbox_t *urgent_lane(actor_t *actor);
 
-// Tries to add actor to actor_queue.
-static void queue_add_actor(actor_queue_t *queue, actor_id_t actor) {
-    if (queue->current_size == CAST_LIMIT) {
-        // actor_queue is full.
-        assert(false);
-    }
+static mailbox_t *message_lane(actor_t *actor, const message_t *message);
 
-    if (actors_pool->actors_data[actor]->in_queue
-        || actors_pool->actors_data[actor]->messages_queue->current_size == 0) {
-        return;
-    }
+static size_t urgent_size(actor_t *actor);
 
-    actors_pool->actors_data[actor]->in_queue = true;
+static bool has_messages(actor_t *actor);
 
-    queue->current_size++;
-    queue->actors[queue->first_empty] = actor;
-    queue->first_empty = (queue->first_empty + 1) % CAST_LIMIT;
+static mailbox_t *next_lane(actor_t *actor);
 
-    // Some threads are waiting for actors.
-    if (actors_pool->waiting_for_actor > 0) {
-        signal_wait_for_actor();
-    }
-}
+static bool next_message(actor_t *actor, message_t *message);
 
-// Return first actor's id from queue.
-static actor_id_t queue_get_actor(actor_queue_t *queue) {
-    if (queue->current_size == 0) {
-        assert(false);
-    }
+static void schedule_actor(actor_t *actor);
 
-    queue->current_size--;
+static void wake_worker();
 
-    actor_id_t result = queue->actors[queue->first_full];
-    queue->actors[queue->first_full] = -1;
-    queue->first_full = (queue->first_full + 1) % CAST_LIMIT;
+static void queue_init(actor_queue_t *queue);
 
-    assert(actors_pool->actors_data[result]->in_queue);
-    return result;
-}
+static void queue_add_actor(actor_queue_t *queue, actor_id_t actor);
 
-static void init_actors_system() {
-    actors_pool = (actors_system_t *) malloc(sizeof(actors_system_t));
+static actor_id_t queue_get_actor(actor_queue_t *queue);
 
-    *actors_pool = (actors_system_t) {
-            .waiting_for_actor = 0,
-            .first_empty = 0,
-            .living_actors = 1, // Fake actor prevents threads from dying
-            .messages_in_system = 0,
-            .thread_collected = 0
-    };
+static deque_array_t *deque_array_create(long capacity);
 
-    actors_pool->actors_queue = (actor_queue_t *) malloc(sizeof(actor_queue_t));
+static void deque_push(worker_t *worker, actor_id_t actor);
 
-    *(actors_pool->actors_queue) = (actor_queue_t) {
-            .first_empty = 0,
-            .first_full = 0,
-            .current_size = 0
-    };
+static actor_id_t deque_steal(worker_t *worker);
 
-    int error_code;
+static bool deque_empty(worker_t *worker);
 
-    error_code = pthread_mutex_init(&actors_pool->mutex, NULL);
-    assert(error_code == 0);
+static actor_id_t deque_pop(worker_t *worker);
 
-    error_code = pthread_cond_init(&actors_pool->wait_for_actor, NULL);
-    assert(error_code == 0);
+static void inbox_push(worker_t *worker, actor_t *actor);
 
-    // Creating threads with default attr.
-    for (size_t thread = 0; thread < POOL_SIZE; ++thread) {
-        error_code = pthread_create(&actors_pool->threads[thread],
-                                    NULL, thread_loop, NULL);
-        assert(error_code == 0);
-    }
-}
+static bool inbox_drain(worker_t *worker);
 
-static void destroy_actors_system() {
-    int error_code;
+static actor_id_t global_queue_pop(actor_queue_t *queue);
 
-    // Collect threads.
-    for (; actors_pool->thread_collected < POOL_SIZE;
-           ++actors_pool->thread_collected) {
-        void *thread_result;
-        error_code = pthread_join(
-                actors_pool->threads[actors_pool->thread_collected],
-                &thread_result);
-        assert(error_code == 0);
-    }
+static actor_id_t find_actor(worker_t *worker);
 
-    error_code = pthread_cond_destroy(&actors_pool->wait_for_actor);
-    assert(error_code == 0);
+static bool work_available();
 
-    error_code = pthread_mutex_destroy(&actors_pool->mutex);
-    assert(error_code == 0);
+static void wait_for_actor();
 
-    // Free memory allocated for actors.
-    for (size_t actor = 0; actor < actors_pool->first_empty; ++actor) {
-        clear_actor(actors_pool->actors_data[actor]);
-    }
+static void release_actor(actor_t *actor);
 
-    free(actors_pool->actors_queue);
-    free(actors_pool);
-    actors_pool = NULL;
-}
+static void perform_actor(actor_id_t actor_id);
 
-static void add_actor(actor_id_t *actor_id, role_t *const role) {
-    lock_mutex();
+static int init_actors_system(const cacti_config_t *config);
 
-    // SIGINT was sent.
-    if (actors_pool->got_sigint) {
-        unlock_mutex();
-        return;
-    }
+static int worker_cpu(const cacti_config_t *config, size_t thread);
 
-    *actor_id = actors_pool->first_empty;
+static void worker_start(worker_t *worker);
 
-    actors_pool->actors_data[*actor_id] = (actor_t *) malloc(sizeof(actor_t));
-    (*actors_pool->actors_data[*actor_id]) = (actor_t) {
-            .id = *actor_id,
-            .is_dead = false,
-            .in_queue = false,
-            .role = role,
-            .state = NULL
-    };
+static void destroy_actors_system();
 
-    actors_pool->actors_data[*actor_id]->messages_queue =
-            (cyclic_queue_t *) malloc(sizeof(cyclic_queue_t));
+static bool add_actor(actor_id_t *actor_id, role_t *const role);
 
-    *(actors_pool->actors_data[*actor_id]->messages_queue) = (cyclic_queue_t) {
-            .first_empty = 0,
-            .first_full = 0,
-            .current_size = 0
-    };
+static size_t add_actors(actor_id_t *actor_ids, role_t *const role,
+                         size_t count);
 
-    actors_pool->first_empty++;
-    actors_pool->living_actors++;
-    unlock_mutex();
-}
+static void clear_actor(actor_t *actor);
 
-static void clear_actor(actor_t *actor) {
-    while (actor->messages_queue->current_size > 0) {
-        free(get_message(actor->messages_queue));
-    }
+static bool park_message(actor_t *actor, const message_t *message);
 
-    free(actor->messages_queue);
-    free(actor);
-}
+static void unpark_messages(actor_t *actor);
 
-// Performs first message of given actor.
-void perform_message(actor_t *current_actor, message_t *message) {
-    if (message->message_type == MSG_SPAWN) {
-        // Data field is the new role.
-        actor_id_t new_actor;
-        add_actor(&new_actor, message->data);
+static void notify_space(actor_t *actor);
 
-        message_t new_message = {
-                .message_type = MSG_HELLO,
-                .nbytes = sizeof(actor_id_t),
-                .data = (void *) current_actor->id
-        };
+static actor_t *pin_actor(actor_id_t actor, int *result);
 
-        // Sends hello message to new actor.
-        send_message(new_actor, new_message);
-    }
-    else if (message->message_type == MSG_GODIE) {
-        lock_mutex();
+static void unpin_actor(actor_id_t actor);
 
-        if (!current_actor->is_dead) {
-            actors_pool->living_actors--;
-        }
-        current_actor->is_dead = true;
+static int push_message(actor_id_t actor, const message_t *message,
+                        bool park);
 
-        unlock_mutex();
-    }
-    else {
-        current_actor->role->prompts[message->message_type](
-                &current_actor->state, message->nbytes, message->data);
-    }
+static bool mailbox_full(actor_id_t actor, const message_t *message);
 
-    free(message);
-    lock_mutex();
-    current_actor->in_queue = false;
-    actors_pool->messages_in_system--;
+static int send_message_until(actor_id_t actor, message_t message,
+                              const struct timespec *deadline);
 
-    // Tries to requeue actor.
-    queue_add_actor(actors_pool->actors_queue, current_actor->id);
-    unlock_mutex();
-}
+static int send_result(int result);
 
-// Thread work loop.
-static void *thread_loop(void *d) {
-    (void) d;
-    int error_code;
+static actor_slot_t *get_slot(size_t index);
 
-    lock_mutex();
-    // Keep working if any actor is alive
-    // or some messages had been added before all actors died.
-    while (thread_keep_working()) {
-        // Sleep when there are no actors.
-        while (actors_pool->actors_queue->current_size == 0
-               && thread_keep_working()) {
-            actors_pool->waiting_for_actor++;
-            error_code = pthread_cond_wait(&actors_pool->wait_for_actor,
-                                           &actors_pool->mutex);
-            assert(error_code == 0);
+static actor_t *get_actor(actor_id_t actor_id);
 
-            actors_pool->waiting_for_actor--;
-        }
-        // Break for threads sleeping on conditional.
-        if (!thread_keep_working()) {
-            break;
-        }
+static void wait_for_senders(actor_slot_t *slot);
 
-        // Perform first actor's message.
-        actor_id_t current_actor_id = queue_get_actor(actors_pool->actors_queue);
-        actor_t *current_actor = actors_pool->actors_data[current_actor_id];
-        message_t *message = get_message(current_actor->messages_queue);
-        unlock_mutex();
+static bool reclaim_actor(actor_t *actor);
 
-        thread_actor_id = current_actor_id;
+void perform_message(actor_t *current_actor, message_t *message);
 
-        perform_message(current_actor, message);
+static group_t *get_group(group_id_t group);
 
-        thread_actor_id = -1;
+static group_members_t *group_members_create(size_t capacity);
 
-        lock_mutex();
-    } // Thread leaves with mutex.
+static void group_compact(group_t *group, size_t capacity);
 
+static void group_destroy(group_t *group);
 
-    // Job here is done, wake other threads.
-    if (actors_pool->waiting_for_actor > 0) {
-        signal_wait_for_actor();
-    }
-    unlock_mutex();
+static void timer_wheel_init();
 
-    return NULL;
-}
+static void timer_wheel_destroy();
 
-// Returns current actor's id.
-actor_id_t actor_id_self() {
-    assert(thread_actor_id != -1);
-    return thread_actor_id;
-}
+static unsigned long long timer_now();
 
-int actor_system_create(actor_id_t *actor, role_t *const role) {
-    if (actors_pool != NULL) {
-        return -1;
-    }
+static void timer_insert(pending_timer_t *timer);
 
-    init_actors_system();
+static size_t timer_cascade(size_t level);
 
-    set_sigint_handler();
+static unsigned long long timer_next();
 
-    add_actor(actor, role);
+static void *timer_loop(void *d);
 
-    lock_mutex();
-    actors_pool->living_actors--; // Undo fake actor.
-    unlock_mutex();
+static int add_timer(actor_id_t actor, message_t message, long delay_us,
+                     long period_us);
 
-    int error_code = send_message(*actor, (message_t) {
-            .message_type = MSG_HELLO,
-            .nbytes = sizeof(actor_id_t),
-            .data = (void *) *actor,
-    });
-    assert(error_code == 0);
+static void blocking_pool_init(size_t limit);
 
-    return 0;
-}
+static void blocking_pool_destroy();
 
-void actor_system_join(actor_id_t actor) {
-    if (actors_pool == NULL || actor < 0
-        || actor >= (actor_id_t) actors_pool->first_empty) {
-        return;
-    }
+static bool blocking_next(actor_t *actor);
 
-    destroy_actors_system();
-}
+static void blocking_pool_add(actor_id_t actor);
 
-// Sends message to certain actor.
-int send_message(actor_id_t actor, message_t message) {
-    lock_mutex();
+static void *blocking_loop(void *d);
 
-    // SIGINT was sent.
-    if (actors_pool->got_sigint) {
-        unlock_mutex();
-        return 0;
+static void *thread_loop(void *d);
+
+
+// Returns system API called by this thread works with, NULL if none.
+static actors_system_t *current_system() {
+    if (!system_chosen) {
+        actors_pool = default_system;
     }
 
-    if (actor < 0 || actor >= (actor_id_t) actors_pool->first_empty) {
-        unlock_mutex();
+    return actors_pool;
+}
+
+// Makes thread work with system until leave_system. Thread is not
+// a pool thread of other system, so its actors are not mixed with
+// actors of the system it belongs to.
+static void enter_system(actors_system_t *system, system_scope_t *scope) {
+    *scope = (system_scope_t) {
+            .system = current_system(),
+            .chosen = system_chosen,
+            .worker = thread_worker,
+            .actor = thread_actor,
+            .actor_id = thread_actor_id
+    };
+
+    if (system != actors_pool) {
+        actors_pool = system;
+        thread_worker = NULL;
+        thread_actor = NULL;
+        thread_actor_id = -1;
+    }
+    system_chosen = true;
+}
+
+static void leave_system(const system_scope_t *scope) {
+    actors_pool = scope->system;
+    system_chosen = scope->chosen;
+    thread_worker = scope->worker;
+    thread_actor = scope->actor;
+    thread_actor_id = scope->actor_id;
+}
+
+// Returns false if there are already SYSTEM_LIMIT systems.
+static bool register_system(actors_system_t *system) {
+    for (size_t i = 0; i < SYSTEM_LIMIT; ++i) {
+        actors_system_t *empty = NULL;
+        if (atomic_compare_exchange_strong(&systems[i], &empty, system)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void unregister_system(actors_system_t *system) {
+    for (size_t i = 0; i < SYSTEM_LIMIT; ++i) {
+        actors_system_t *registered = system;
+        if (atomic_compare_exchange_strong(&systems[i], &registered, NULL)) {
+            return;
+        }
+    }
+}
+
+static void handle_sigint(int sig) {
+    if (sig == SIGINT) {
+        for (size_t i = 0; i < SYSTEM_LIMIT; ++i) {
+            actors_system_t *system = atomic_load(&systems[i]);
+            if (system != NULL) {
+                system->got_sigint = true;
+            }
+        }
+    }
+}
+
+static void set_sigint_handler() {
+    signal(SIGINT, handle_sigint);
+}
+
+static bool thread_keep_working() {
+    if (!actors_pool->got_sigint) {
+        return actors_pool->living_actors > 0 || actors_pool->messages_in_system > 0;
+    }
+    else {
+        return actors_pool->messages_in_system > 0;
+    }
+}
+
+// Time of waiting is measured only if mutex is already taken.
+static void lock_mutex() {
+    int error_code = pthread_mutex_trylock(&actors_pool->mutex);
+    if (error_code == 0) {
+        return;
+    }
+    assert(error_code == EBUSY);
+
+    unsigned long long start = monotonic_ns();
+    error_code = pthread_mutex_lock(&actors_pool->mutex);
+    assert(error_code == 0);
+
+    if (thread_worker != NULL) {
+        atomic_fetch_add_explicit(&thread_worker->lock_wait_ns,
+                                  monotonic_ns() - start,
+                                  memory_order_relaxed);
+    }
+}
+
+static void unlock_mutex() {
+    int error_code = pthread_mutex_unlock(&actors_pool->mutex);
+    assert(error_code == 0);
+}
+
+static unsigned long long monotonic_ns() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (unsigned long long) time.tv_sec * 1000000000
+           + (unsigned long long) time.tv_nsec;
+}
+
+// Counts messages rejected with -1 or -2, also on behalf of sending actor.
+static void count_send_failures(size_t count) {
+    atomic_fetch_add_explicit(&actors_pool->send_failures, count,
+                              memory_order_relaxed);
+
+    if (thread_actor != NULL) {
+        atomic_fetch_add_explicit(&thread_actor->send_failures, count,
+                                  memory_order_relaxed);
+    }
+}
+
+static void trace_ring_init(trace_ring_t *ring, size_t capacity) {
+    atomic_init(&ring->position, 0);
+    ring->capacity = capacity;
+    ring->events = capacity > 0
+                   ? (trace_event_t *) malloc(capacity * sizeof(trace_event_t))
+                   : NULL;
+}
+
+// Puts event in ring of current thread. Only pool threads own their rings.
+static void trace_event(trace_type_t type, actor_id_t actor,
+                        message_type_t message_type) {
+    trace_ring_t *ring = thread_worker != NULL ? &thread_worker->trace
+                                               : &actors_pool->trace_external;
+    size_t position = atomic_fetch_add_explicit(&ring->position, 1,
+                                                memory_order_relaxed);
+
+    ring->events[position % ring->capacity] = (trace_event_t) {
+            .time = monotonic_ns(),
+            .type = type,
+            .actor = actor,
+            .message_type = message_type
+    };
+}
+
+// Writes events of ring as Chrome trace events of thread.
+static void trace_write_ring(FILE *file, trace_ring_t *ring, size_t thread,
+                             bool *first) {
+    static const char *const names[] = {
+            [TRACE_SPAWN] = "spawn",
+            [TRACE_ENQUEUE] = "enqueue",
+            [TRACE_DEQUEUE] = "dequeue",
+            [TRACE_HANDLER_BEGIN] = "handler",
+            [TRACE_HANDLER_END] = "handler",
+            [TRACE_GODIE] = "godie",
+            [TRACE_SLEEP_BEGIN] = "sleep",
+            [TRACE_SLEEP_END] = "sleep"
+    };
+
+    size_t end = atomic_load(&ring->position);
+    size_t begin = end > ring->capacity ? end - ring->capacity : 0;
+
+    for (size_t position = begin; position < end; ++position) {
+        trace_event_t *event = &ring->events[position % ring->capacity];
+        const char *phase;
+
+        switch (event->type) {
+            case TRACE_HANDLER_BEGIN:
+            case TRACE_SLEEP_BEGIN:
+                phase = "B";
+                break;
+            case TRACE_HANDLER_END:
+            case TRACE_SLEEP_END:
+                phase = "E";
+                break;
+            default:
+                phase = "i";
+        }
+
+        double microseconds = (double) (event->time - actors_pool->trace_start)
+                              / 1000;
+
+        fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,"
+                      "\"pid\":1,\"tid\":%zu,\"s\":\"t\","
+                      "\"args\":{\"actor\":%ld,\"type\":%ld}}",
+                *first ? "" : ",", names[event->type], phase, microseconds,
+                thread, event->actor, event->message_type);
+        *first = false;
+    }
+}
+
+// Writes all recorded events as Chrome trace JSON, one track per thread.
+static int trace_write(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+
+    bool first = true;
+    fprintf(file, "{\"traceEvents\":[");
+
+    for (size_t thread = 0; thread <= actors_pool->pool_size; ++thread) {
+        bool external = thread == actors_pool->pool_size;
+
+        fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                      "\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s %zu\"}}",
+                first ? "" : ",", thread,
+                external ? "external" : "worker", thread);
+        first = false;
+
+        trace_write_ring(file, external ? &actors_pool->trace_external
+                                        : &actors_pool->workers[thread].trace,
+                         thread, &first);
+    }
+
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+// Sleeps while futex word holds value. May return spuriously.
+static void futex_wait(atomic_uint *word, unsigned value) {
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_uint *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// Wakes worker if it is parked. Returns false if it was not.
+static bool unpark_worker(worker_t *worker) {
+    unsigned parked = WORKER_PARKED;
+
+    if (atomic_load_explicit(&worker->parked, memory_order_relaxed)
+        == WORKER_PARKED
+        && atomic_compare_exchange_strong(&worker->parked, &parked,
+                                          WORKER_AWAKE)) {
+        futex_wake(&worker->parked);
+        return true;
+    }
+
+    return false;
+}
+
+static void wake_all_workers() {
+    for (size_t thread = 0; thread < actors_pool->pool_size; ++thread) {
+        unpark_worker(&actors_pool->workers[thread]);
+    }
+}
+
+static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Marks messages as performed (or rejected).
+// Wakes sleeping threads if system has just finished its work.
+static void messages_done(size_t count) {
+    atomic_fetch_sub(&actors_pool->messages_in_system, count);
+
+    if (!thread_keep_working()) {
+        wake_all_workers();
+    }
+}
+
+// Messages holding buffer hold references to it.
+static void message_retain(const message_t *message) {
+    if (message->buf != NULL) {
+        cacti_buf_retain(message->buf);
+    }
+}
+
+static void message_release(const message_t *message) {
+    if (message->buf != NULL) {
+        cacti_buf_release(message->buf);
+    }
+}
+
+static void mailbox_init(mailbox_t *mailbox) {
+    atomic_init(&mailbox->size, 0);
+    atomic_init(&mailbox->producers, 0);
+    atomic_init(&mailbox->high_water, 0);
+
+    atomic_init(&mailbox->tail, &closed_segment);
+    atomic_init(&mailbox->first, NULL);
+    mailbox->head = &closed_segment;
+    mailbox->retired = NULL;
+}
+
+// Segment big enough for twice current number of messages.
+static mailbox_segment_t *segment_create(size_t messages) {
+    size_t capacity = MAILBOX_MIN_CAPACITY;
+    while (capacity < 2 * messages) {
+        capacity *= 2;
+    }
+    if (capacity > actors_pool->mailbox_limit) {
+        capacity = actors_pool->mailbox_limit;
+    }
+
+    mailbox_segment_t *segment;
+    if (capacity == MAILBOX_MIN_CAPACITY && thread_worker != NULL
+        && thread_worker->spare_rings != NULL) {
+        segment = thread_worker->spare_rings;
+        thread_worker->spare_rings = segment->retired;
+        thread_worker->spare_count--;
+    }
+    else {
+        segment = (mailbox_segment_t *) malloc(
+                sizeof(mailbox_segment_t) + capacity * sizeof(mailbox_slot_t));
+    }
+
+    atomic_init(&segment->enqueue_position, 0);
+    segment->dequeue_position = 0;
+    atomic_init(&segment->next, NULL);
+    segment->retired = NULL;
+    segment->capacity = capacity;
+
+    for (size_t slot = 0; slot < capacity; ++slot) {
+        atomic_init(&segment->slots[slot].sequence, slot);
+    }
+
+    return segment;
+}
+
+// Smallest rings freed by pool thread are kept for reuse, as actors
+// woken up by single message need them again at once.
+static void segment_free(mailbox_segment_t *segment) {
+    if (segment->capacity == MAILBOX_MIN_CAPACITY && thread_worker != NULL
+        && thread_worker->spare_count < SPARE_RINGS) {
+        segment->retired = thread_worker->spare_rings;
+        thread_worker->spare_rings = segment;
+        thread_worker->spare_count++;
+        return;
+    }
+
+    free(segment);
+}
+
+// Links new segment after closed one and moves tail forward.
+static void segment_append(mailbox_t *mailbox, mailbox_segment_t *segment) {
+    _Atomic(mailbox_segment_t *) *link = segment == &closed_segment
+                                         ? &mailbox->first : &segment->next;
+    mailbox_segment_t *next = atomic_load(link);
+
+    if (next == NULL) {
+        mailbox_segment_t *created = segment_create(atomic_load(&mailbox->size));
+
+        if (atomic_compare_exchange_strong(link, &next, created)) {
+            next = created;
+        }
+        else {
+            // Other producer was faster.
+            segment_free(created);
+        }
+    }
+
+    atomic_compare_exchange_strong(&mailbox->tail, &segment, next);
+}
+
+// Frees retired segments if no producer is inside mailbox.
+// Segments are retired only after tail has moved past them,
+// so producers coming later can not reach them.
+static void mailbox_reclaim(mailbox_t *mailbox) {
+    if (atomic_load(&mailbox->producers) > 0) {
+        return;
+    }
+
+    while (mailbox->retired != NULL) {
+        mailbox_segment_t *segment = mailbox->retired;
+        mailbox->retired = segment->retired;
+        segment_free(segment);
+    }
+
+    // Closed segment is left behind too, it can be used again.
+    if (mailbox->head != &closed_segment) {
+        atomic_store(&mailbox->first, NULL);
+    }
+}
+
+static void segment_retire(mailbox_t *mailbox, mailbox_segment_t *segment,
+                           mailbox_segment_t *next) {
+    mailbox_segment_t *expected = segment;
+    atomic_compare_exchange_strong(&mailbox->tail, &expected, next);
+
+    if (segment == &closed_segment) {
+        mailbox_reclaim(mailbox);
+        return;
+    }
+
+    segment->retired = mailbox->retired;
+    mailbox->retired = segment;
+
+    mailbox_reclaim(mailbox);
+}
+
+// Returns first published slot of mailbox or NULL if mailbox is empty
+// or first message is not published yet. Moves past drained closed segments.
+// Only thread owning actor can call it.
+static mailbox_slot_t *mailbox_front(mailbox_t *mailbox) {
+    while (true) {
+        mailbox_segment_t *segment = mailbox->head;
+        size_t position = segment->dequeue_position;
+
+        if (segment->capacity > 0) {
+            mailbox_slot_t *slot = &segment->slots[position % segment->capacity];
+
+            if (atomic_load_explicit(&slot->sequence, memory_order_acquire)
+                == position + 1) {
+                return slot;
+            }
+        }
+
+        // Segment can be left only if it is closed and every reserved
+        // message was performed.
+        if (atomic_load(&segment->enqueue_position)
+            != (position | SEGMENT_CLOSED)) {
+            return NULL;
+        }
+
+        mailbox_segment_t *next = segment == &closed_segment
+                                  ? atomic_load(&mailbox->first)
+                                  : atomic_load(&segment->next);
+        if (next == NULL) {
+            return NULL;
+        }
+
+        mailbox->head = next;
+        segment_retire(mailbox, segment, next);
+    }
+}
+
+// Copies out message that was first in actor's mailbox.
+// Returns false if mailbox is empty or first message is not published yet.
+// Only thread owning actor can call it.
+static bool get_message(mailbox_t *mailbox, message_t *message) {
+    mailbox_slot_t *slot = mailbox_front(mailbox);
+    if (slot == NULL) {
+        return false;
+    }
+
+    mailbox_segment_t *segment = mailbox->head;
+    size_t position = segment->dequeue_position;
+
+    *message = slot->message;
+    atomic_store_explicit(&slot->sequence, position + segment->capacity,
+                          memory_order_release);
+    segment->dequeue_position = position + 1;
+
+    atomic_fetch_sub(&mailbox->size, 1);
+
+    return true;
+}
+
+// Tries to put messages in given segment, reserving run of free slots
+// with single CAS. Returns number of messages put, 0 if segment is full
+// or closed.
+static size_t segment_add_messages(mailbox_segment_t *segment,
+                                   const message_t *messages, size_t count) {
+    size_t position = atomic_load_explicit(&segment->enqueue_position,
+                                           memory_order_relaxed);
+    size_t reserved;
+
+    while (true) {
+        if (position & SEGMENT_CLOSED) {
+            return 0;
+        }
+
+        mailbox_slot_t *slot = &segment->slots[position % segment->capacity];
+        size_t sequence = atomic_load_explicit(&slot->sequence,
+                                               memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+
+        if (difference == 0) {
+            // Following slots are taken as long as they are free too.
+            reserved = 1;
+            while (reserved < count && reserved < segment->capacity) {
+                slot = &segment->slots[(position + reserved)
+                                       % segment->capacity];
+                if (atomic_load_explicit(&slot->sequence, memory_order_acquire)
+                    != position + reserved) {
+                    break;
+                }
+                reserved++;
+            }
+
+            if (atomic_compare_exchange_weak_explicit(
+                    &segment->enqueue_position, &position, position + reserved,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (difference < 0) {
+            // Slot was not consumed yet, ring is full.
+            atomic_fetch_or(&segment->enqueue_position, SEGMENT_CLOSED);
+            return 0;
+        }
+        else {
+            position = atomic_load_explicit(&segment->enqueue_position,
+                                            memory_order_relaxed);
+        }
+    }
+
+    for (size_t i = 0; i < reserved; ++i) {
+        mailbox_slot_t *slot = &segment->slots[(position + i)
+                                               % segment->capacity];
+        slot->message = messages[i];
+        atomic_store_explicit(&slot->sequence, position + i + 1,
+                              memory_order_release);
+    }
+
+    return reserved;
+}
+
+// Adds as many messages to actor's mailbox as fit in it.
+// Returns number of added messages.
+static size_t add_messages(mailbox_t *mailbox, const message_t *messages,
+                           size_t count) {
+    size_t size = atomic_load(&mailbox->size);
+    size_t accepted;
+
+    do {
+        size_t space = actors_pool->mailbox_limit > size
+                       ? actors_pool->mailbox_limit - size : 0;
+        accepted = count < space ? count : space;
+        if (accepted == 0) {
+            return 0;
+        }
+    } while (!atomic_compare_exchange_weak(&mailbox->size, &size,
+                                           size + accepted));
+
+    size_t high_water = atomic_load_explicit(&mailbox->high_water,
+                                             memory_order_relaxed);
+    while (high_water < size + accepted
+           && !atomic_compare_exchange_weak_explicit(
+                   &mailbox->high_water, &high_water, size + accepted,
+                   memory_order_relaxed, memory_order_relaxed)) {
+    }
+
+    atomic_fetch_add(&mailbox->producers, 1);
+
+    size_t added = 0;
+    mailbox_segment_t *segment = atomic_load(&mailbox->tail);
+    while (added < accepted) {
+        size_t put = segment_add_messages(segment, messages + added,
+                                          accepted - added);
+        if (put == 0) {
+            segment_append(mailbox, segment);
+            segment = atomic_load(&mailbox->tail);
+        }
+        added += put;
+    }
+
+    atomic_fetch_sub(&mailbox->producers, 1);
+
+    return accepted;
+}
+
+// Adds message to actor's mailbox. Returns false if mailbox is full.
+static bool add_message(mailbox_t *mailbox, const message_t *message) {
+    return add_messages(mailbox, message, 1) == 1;
+}
+
+// Checks if there is published message on front of mailbox.
+// Only thread owning actor can call it.
+static bool mailbox_empty(mailbox_t *mailbox) {
+    return mailbox_front(mailbox) == NULL;
+}
+
+// Returns actor's urgent lane, creating it if it has none yet.
+static mailbox_t *urgent_lane(actor_t *actor) {
+    mailbox_t *urgent = atomic_load_explicit(&actor->urgent,
+                                             memory_order_acquire);
+
+    if (urgent == NULL) {
+        mailbox_t *created = (mailbox_t *) malloc(sizeof(mailbox_t));
+        mailbox_init(created);
+
+        if (atomic_compare_exchange_strong(&actor->urgent, &urgent, created)) {
+            urgent = created;
+        }
+        else {
+            // Other sender was faster.
+            free(created);
+        }
+    }
+
+    return urgent;
+}
+
+static mailbox_t *message_lane(actor_t *actor, const message_t *message) {
+    return message->priority > MSG_PRIORITY_NORMAL ? urgent_lane(actor)
+                                                   : &actor->mailbox;
+}
+
+// Number of accepted messages in urgent lane.
+static size_t urgent_size(actor_t *actor) {
+    mailbox_t *urgent = atomic_load_explicit(&actor->urgent,
+                                             memory_order_acquire);
+
+    return urgent != NULL ? atomic_load(&urgent->size) : 0;
+}
+
+// Checks if any message was accepted to either lane.
+static bool has_messages(actor_t *actor) {
+    return atomic_load(&actor->mailbox.size) > 0 || urgent_size(actor) > 0;
+}
+
+// Returns lane next message of owned actor comes from, NULL if both
+// look empty. Urgent lane goes first, but after URGENT_BURST urgent
+// messages in a row one normal message gets its turn.
+static mailbox_t *next_lane(actor_t *actor) {
+    mailbox_t *urgent = atomic_load_explicit(&actor->urgent,
+                                             memory_order_acquire);
+    bool urgent_ready = urgent != NULL && !mailbox_empty(urgent);
+
+    if (urgent_ready && actor->urgent_streak < URGENT_BURST) {
+        return urgent;
+    }
+    if (!mailbox_empty(&actor->mailbox)) {
+        return &actor->mailbox;
+    }
+
+    return urgent_ready ? urgent : NULL;
+}
+
+static bool next_message(actor_t *actor, message_t *message) {
+    mailbox_t *lane = next_lane(actor);
+    if (lane == NULL || !get_message(lane, message)) {
+        return false;
+    }
+
+    actor->urgent_streak = lane != &actor->mailbox ? actor->urgent_streak + 1
+                                                   : 0;
+    return true;
+}
+
+// Gives memory of drained ring back by replacing it with the shared
+// closed segment, so idle actor holds no slots. Only thread owning actor
+// can call it.
+static void mailbox_shrink(mailbox_t *mailbox) {
+    mailbox_segment_t *segment = mailbox->head;
+    size_t position = segment->dequeue_position;
+
+    if (segment == &closed_segment) {
+        return;
+    }
+
+    // Closed segment has to be left behind by all producers first.
+    if (atomic_load(&mailbox->first) != NULL) {
+        mailbox_reclaim(mailbox);
+        if (atomic_load(&mailbox->first) != NULL) {
+            return;
+        }
+    }
+
+    // Fails if ring is not empty or producers already closed it.
+    if (!atomic_compare_exchange_strong(&segment->enqueue_position, &position,
+                                        position | SEGMENT_CLOSED)) {
+        return;
+    }
+
+    mailbox_segment_t *next = NULL;
+    if (atomic_compare_exchange_strong(&segment->next, &next,
+                                       &closed_segment)) {
+        next = &closed_segment;
+    }
+
+    // Otherwise producers have already appended bigger segment.
+    mailbox->head = next;
+    segment_retire(mailbox, segment, next);
+}
+
+// Frees every segment, mailbox is not used by anyone anymore.
+static void mailbox_destroy(mailbox_t *mailbox) {
+    mailbox_reclaim(mailbox);
+    assert(mailbox->retired == NULL);
+
+    mailbox_segment_t *segment = mailbox->head != &closed_segment
+                                 ? mailbox->head : atomic_load(&mailbox->first);
+    while (segment != NULL && segment != &closed_segment) {
+        mailbox_segment_t *next = atomic_load(&segment->next);
+        free(segment);
+        segment = next;
+    }
+}
+
+// Makes actor runnable if its not already scheduled.
+// Actor goes to inbox of its home thread, unless it is the current one,
+// then to own deque. Threads outside of the pool push new actors
+// to actors_queue. Urgent actors go to urgent_queue.
+static void schedule_actor(actor_t *actor) {
+    if (atomic_exchange(&actor->in_queue, true)) {
+        return;
+    }
+
+    size_t home = atomic_load_explicit(&actor->home, memory_order_relaxed);
+
+    if (atomic_load_explicit(&actor->priority, memory_order_relaxed)
+        > MSG_PRIORITY_NORMAL || urgent_size(actor) > 0) {
+        lock_mutex();
+        queue_add_actor(actors_pool->urgent_queue, actor->id);
+        unlock_mutex();
+    }
+    else if (thread_worker != NULL
+             && (home == thread_worker->index || home == NO_HOME)) {
+        deque_push(thread_worker, actor->id);
+    }
+    else if (home != NO_HOME) {
+        worker_t *worker = &actors_pool->workers[home];
+        inbox_push(worker, actor);
+
+        // Pairs with fence in wait_for_actor, like in wake_worker.
+        // Awake home thread which is not performing actor takes it soon,
+        // busy one gets to it later, unless other thread steals it.
+        atomic_thread_fence(memory_order_seq_cst);
+        if (unpark_worker(worker) || !atomic_load(&worker->busy)) {
+            return;
+        }
+    }
+    else {
+        lock_mutex();
+        queue_add_actor(actors_pool->actors_queue, actor->id);
+        unlock_mutex();
+    }
+
+    wake_worker();
+}
+
+// Wakes one thread if any is waiting for actor.
+// Pairs with fence in wait_for_actor, so either sleeping thread sees
+// new actor or this thread sees it sleeping.
+static void wake_worker() {
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&actors_pool->waiting_for_actor,
+                             memory_order_relaxed) == 0) {
+        return;
+    }
+
+    // Search starts after current thread, so wakeups are spread.
+    size_t first = thread_worker != NULL ? thread_worker->index + 1 : 0;
+    for (size_t i = 0; i < actors_pool->pool_size; ++i) {
+        if (unpark_worker(&actors_pool->workers[(first + i)
+                                                % actors_pool->pool_size])) {
+            return;
+        }
+    }
+}
+
+// Empty queue of initial capacity.
+static void queue_init(actor_queue_t *queue) {
+    queue->capacity = ACTOR_QUEUE_INITIAL_CAPACITY;
+    queue->actors = (actor_id_t *) malloc(
+            ACTOR_QUEUE_INITIAL_CAPACITY * sizeof(actor_id_t));
+
+    queue->first_empty = 0;
+    queue->first_full = 0;
+    atomic_init(&queue->current_size, 0);
+}
+
+// Adds actor to actor_queue. Caller has to own actor's in_queue flag
+// and hold mutex.
+static void queue_add_actor(actor_queue_t *queue, actor_id_t actor) {
+    if (queue->current_size == queue->capacity) {
+        // actor_queue is full, unroll it into twice bigger array.
+        actor_id_t *actors = (actor_id_t *) malloc(
+                2 * queue->capacity * sizeof(actor_id_t));
+
+        for (size_t i = 0; i < queue->capacity; ++i) {
+            actors[i] = queue->actors[(queue->first_full + i) % queue->capacity];
+        }
+
+        free(queue->actors);
+        queue->actors = actors;
+        queue->first_full = 0;
+        queue->first_empty = queue->capacity;
+        queue->capacity *= 2;
+    }
+
+    queue->actors[queue->first_empty] = actor;
+    queue->first_empty = (queue->first_empty + 1) % queue->capacity;
+    queue->current_size++;
+}
+
+// Return first actor's id from queue.
+static actor_id_t queue_get_actor(actor_queue_t *queue) {
+    if (queue->current_size == 0) {
+        assert(false);
+    }
+
+    queue->current_size--;
+
+    actor_id_t result = queue->actors[queue->first_full];
+    queue->actors[queue->first_full] = -1;
+    queue->first_full = (queue->first_full + 1) % queue->capacity;
+
+    assert(get_actor(result)->in_queue);
+    return result;
+}
+
+static deque_array_t *deque_array_create(long capacity) {
+    deque_array_t *array = (deque_array_t *) malloc(
+            sizeof(deque_array_t) + capacity * sizeof(atomic_long));
+
+    array->capacity = capacity;
+    array->previous = NULL;
+
+    return array;
+}
+
+// Pushes actor on bottom of worker's deque. Only owner can call it.
+static void deque_push(worker_t *worker, actor_id_t actor) {
+    long bottom = atomic_load_explicit(&worker->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&worker->top, memory_order_acquire);
+    deque_array_t *array = atomic_load_explicit(&worker->array,
+                                                memory_order_relaxed);
+
+    if (bottom - top > array->capacity - 1) {
+        // Deque is full, copy it to bigger array.
+        deque_array_t *bigger = deque_array_create(2 * array->capacity);
+        for (long i = top; i < bottom; ++i) {
+            atomic_store_explicit(
+                    &bigger->actors[i % bigger->capacity],
+                    atomic_load_explicit(&array->actors[i % array->capacity],
+                                         memory_order_relaxed),
+                    memory_order_relaxed);
+        }
+
+        bigger->previous = array;
+        atomic_store_explicit(&worker->array, bigger, memory_order_release);
+        array = bigger;
+    }
+
+    atomic_store_explicit(&array->actors[bottom % array->capacity], actor,
+                          memory_order_relaxed);
+    atomic_store_explicit(&worker->bottom, bottom + 1, memory_order_release);
+}
+
+// Steals actor from top of other worker's deque.
+static actor_id_t deque_steal(worker_t *worker) {
+    long top = atomic_load_explicit(&worker->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&worker->bottom, memory_order_acquire);
+
+    if (top >= bottom) {
+        return DEQUE_EMPTY;
+    }
+
+    deque_array_t *array = atomic_load_explicit(&worker->array,
+                                                memory_order_acquire);
+    actor_id_t result = atomic_load_explicit(
+            &array->actors[top % array->capacity], memory_order_relaxed);
+
+    if (!atomic_compare_exchange_strong_explicit(
+            &worker->top, &top, top + 1,
+            memory_order_seq_cst, memory_order_relaxed)) {
+        // Lost race with owner or other thief.
+        return DEQUE_ABORT;
+    }
+
+    return result;
+}
+
+static bool deque_empty(worker_t *worker) {
+    return atomic_load(&worker->top) >= atomic_load(&worker->bottom);
+}
+
+// Takes actor from top of worker's own deque.
+// Requeued actors land on bottom, so taking in FIFO order
+// prevents one flooded actor from starving others.
+static actor_id_t deque_pop(worker_t *worker) {
+    actor_id_t result;
+
+    do {
+        result = deque_steal(worker);
+    } while (result == DEQUE_ABORT);
+
+    return result;
+}
+
+// Any thread can push, actor is in at most one inbox as it is scheduled once.
+static void inbox_push(worker_t *worker, actor_t *actor) {
+    atomic_fetch_add_explicit(&worker->inbox_size, 1, memory_order_relaxed);
+    actor_t *first = atomic_load_explicit(&worker->inbox, memory_order_relaxed);
+
+    do {
+        // Stamp is written before inbox is seen nonempty, so thieves
+        // never read older one.
+        if (first == NULL) {
+            atomic_store_explicit(&worker->inbox_since, monotonic_ns(),
+                                  memory_order_relaxed);
+        }
+        actor->inbox_next = first;
+    } while (!atomic_compare_exchange_weak(&worker->inbox, &first, actor));
+}
+
+// Moves all actors from worker's inbox to deque of current thread,
+// oldest first. Returns false if inbox was empty.
+static bool inbox_drain(worker_t *worker) {
+    if (atomic_load_explicit(&worker->inbox, memory_order_relaxed) == NULL) {
+        return false;
+    }
+
+    actor_t *actor = atomic_exchange(&worker->inbox, NULL);
+    if (actor == NULL) {
+        return false;
+    }
+
+    actor_t *oldest = NULL;
+    size_t drained = 0;
+    while (actor != NULL) {
+        actor_t *next = actor->inbox_next;
+        actor->inbox_next = oldest;
+        oldest = actor;
+        actor = next;
+        drained++;
+    }
+    atomic_fetch_sub_explicit(&worker->inbox_size, drained,
+                              memory_order_relaxed);
+
+    // Pushed actor can be stolen and scheduled again at once.
+    while (oldest != NULL) {
+        actor_t *next = oldest->inbox_next;
+        deque_push(thread_worker, oldest->id);
+        oldest = next;
+    }
+
+    return true;
+}
+
+// Takes actor scheduled from outside of the pool.
+static actor_id_t global_queue_pop(actor_queue_t *queue) {
+    actor_id_t result = DEQUE_EMPTY;
+
+    if (atomic_load(&queue->current_size) > 0) {
+        lock_mutex();
+        if (queue->current_size > 0) {
+            result = queue_get_actor(queue);
+        }
+        unlock_mutex();
+    }
+
+    return result;
+}
+
+// Looks for runnable actor: urgent actors first, then own inbox and deque,
+// then actors scheduled from outside of the pool, then steals from deques
+// of other workers and at last from their inboxes. Every URGENT_BURST-th
+// search skips urgent actors, so they can not starve the others.
+static actor_id_t find_actor(worker_t *worker) {
+    actor_id_t result = DEQUE_EMPTY;
+
+    if (++worker->searches % URGENT_BURST != 0) {
+        result = global_queue_pop(actors_pool->urgent_queue);
+    }
+    if (result == DEQUE_EMPTY && worker->searches % GLOBAL_QUEUE_INTERVAL == 0) {
+        result = global_queue_pop(actors_pool->actors_queue);
+    }
+    if (result == DEQUE_EMPTY) {
+        inbox_drain(worker);
+        result = deque_pop(worker);
+    }
+    if (result == DEQUE_EMPTY) {
+        result = global_queue_pop(actors_pool->actors_queue);
+    }
+    if (result == DEQUE_EMPTY) {
+        result = global_queue_pop(actors_pool->urgent_queue);
+    }
+    if (result != DEQUE_EMPTY) {
+        return result;
+    }
+
+    // Threads of the same NUMA node are robbed first,
+    // as their actors' memory is local.
+    bool contended = true;
+    while (contended) {
+        contended = false;
+
+        for (size_t i = 1; i < 2 * actors_pool->pool_size; ++i) {
+            worker_t *victim =
+                    &actors_pool->workers[(worker->index + i) % actors_pool->pool_size];
+            if ((i < actors_pool->pool_size) != (victim->node == worker->node)) {
+                continue;
+            }
+
+            result = deque_steal(victim);
+
+            if (result == DEQUE_ABORT) {
+                contended = true;
+            }
+            else if (result != DEQUE_EMPTY) {
+                return result;
+            }
+        }
+    }
+
+    // Actors waiting too long for their busy home thread migrate to this one.
+    for (size_t i = 1; i < actors_pool->pool_size; ++i) {
+        worker_t *victim =
+                &actors_pool->workers[(worker->index + i) % actors_pool->pool_size];
+
+        if (atomic_load(&victim->inbox) == NULL
+            || monotonic_ns() - atomic_load_explicit(&victim->inbox_since,
+                                                     memory_order_relaxed)
+               < actors_pool->inbox_patience_ns) {
+            continue;
+        }
+        if (inbox_drain(victim)) {
+            result = deque_pop(worker);
+            if (result != DEQUE_EMPTY) {
+                return result;
+            }
+        }
+    }
+
+    return DEQUE_EMPTY;
+}
+
+// Checks if any thread could find runnable actor.
+static bool work_available() {
+    if (atomic_load(&actors_pool->actors_queue->current_size) > 0
+        || atomic_load(&actors_pool->urgent_queue->current_size) > 0) {
+        return true;
+    }
+
+    for (size_t i = 0; i < actors_pool->pool_size; ++i) {
+        if (!deque_empty(&actors_pool->workers[i])
+            || atomic_load(&actors_pool->workers[i].inbox) != NULL) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Parks thread on its futex until some actor is scheduled
+// or system finishes. No lock is taken on either side.
+static void wait_for_actor() {
+    worker_t *worker = thread_worker;
+
+    atomic_store(&worker->parked, WORKER_PARKED);
+    atomic_fetch_add(&actors_pool->waiting_for_actor, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (!work_available() && thread_keep_working()) {
+        unsigned long long start = monotonic_ns();
+        TRACE(TRACE_SLEEP_BEGIN, -1, 0);
+
+        while (atomic_load(&worker->parked) == WORKER_PARKED) {
+            futex_wait(&worker->parked, WORKER_PARKED);
+        }
+
+        TRACE(TRACE_SLEEP_END, -1, 0);
+
+        atomic_fetch_add_explicit(&worker->idle_ns, monotonic_ns() - start,
+                                  memory_order_relaxed);
+    }
+
+    atomic_store(&worker->parked, WORKER_AWAKE);
+    atomic_fetch_sub(&actors_pool->waiting_for_actor, 1);
+}
+
+static int init_actors_system(const cacti_config_t *config) {
+    long online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    // Zero fields of configuration mean defaults.
+    size_t pool_size = config->threads > 0 ? config->threads
+                       : (online_cpus > 0 ? (size_t) online_cpus : POOL_SIZE);
+    size_t mailbox_limit = config->mailbox_limit > 0 ? config->mailbox_limit
+                           : ACTOR_QUEUE_LIMIT;
+    size_t parked_limit = config->parked_limit > 0 ? config->parked_limit
+                          : PARKED_LIMIT;
+    size_t cast_limit = config->cast_limit > 0 ? config->cast_limit
+                        : CAST_LIMIT;
+    size_t batch = config->batch > 0 ? config->batch : MESSAGE_BATCH;
+
+    // Sequence numbers of mailbox slots are compared as signed differences
+    // and highest bit marks closed segment.
+    if (mailbox_limit > (size_t) INTPTR_MAX / 2) {
+        return -1;
+    }
+
+    // Slot index has to fit in actor's id.
+    if (cast_limit > (size_t) ACTOR_INDEX_MASK + 1) {
+        return -1;
+    }
+
+    actors_pool = (actors_system_t *) malloc(sizeof(actors_system_t));
+    if (!register_system(actors_pool)) {
+        free(actors_pool);
+        actors_pool = NULL;
+        return -1;
+    }
+
+    actors_pool->pool_size = pool_size;
+    actors_pool->mailbox_limit = mailbox_limit;
+    actors_pool->parked_limit = parked_limit;
+    actors_pool->cast_limit = cast_limit;
+    actors_pool->batch = batch;
+
+    size_t chunks = (cast_limit + ACTOR_CHUNK_SIZE - 1) / ACTOR_CHUNK_SIZE;
+    actors_pool->actors_data = (_Atomic(actor_slot_t *) *) malloc(
+            chunks * sizeof(_Atomic(actor_slot_t *)));
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        atomic_init(&actors_pool->actors_data[chunk], NULL);
+    }
+    actors_pool->workers = (worker_t *) aligned_alloc(
+            _Alignof(worker_t), pool_size * sizeof(worker_t));
+
+    actors_pool->groups = (_Atomic(group_t *) *) malloc(
+            GROUP_LIMIT * sizeof(_Atomic(group_t *)));
+    for (size_t group = 0; group < GROUP_LIMIT; ++group) {
+        atomic_init(&actors_pool->groups[group], NULL);
+    }
+    actors_pool->groups_count = 0;
+
+    atomic_init(&actors_pool->waiting_for_actor, 0);
+    actors_pool->idle_spins = config->idle_spins > 0 ? config->idle_spins
+                              : IDLE_SPINS;
+    actors_pool->idle_yields = config->idle_yields > 0 ? config->idle_yields
+                               : IDLE_YIELDS;
+    size_t patience_us = config->inbox_patience_us > 0
+                         ? config->inbox_patience_us : INBOX_PATIENCE_US;
+    actors_pool->inbox_patience_ns = patience_us < ULLONG_MAX / 1000
+                                     ? patience_us * 1000ULL : ULLONG_MAX;
+    atomic_init(&actors_pool->first_empty, 0);
+    actors_pool->free_slots = NO_FREE_SLOT;
+    // Fake actor prevents threads from dying.
+    atomic_init(&actors_pool->living_actors, 1);
+    atomic_init(&actors_pool->messages_in_system, 0);
+    atomic_init(&actors_pool->send_failures, 0);
+
+    // Tracing can be turned on without changing program, by environment.
+    const char *trace_path = config->trace_path != NULL ? config->trace_path
+                             : getenv("CACTI_TRACE");
+    size_t trace_events = config->trace_events > 0 ? config->trace_events
+                          : TRACE_EVENTS;
+
+    actors_pool->tracing = trace_path != NULL || config->trace_events > 0;
+    actors_pool->trace_events = actors_pool->tracing ? trace_events : 0;
+    actors_pool->trace_path = trace_path != NULL ? strdup(trace_path) : NULL;
+    actors_pool->trace_start = monotonic_ns();
+    trace_ring_init(&actors_pool->trace_external,
+                    actors_pool->tracing ? trace_events : 0);
+    atomic_init(&actors_pool->got_sigint, false);
+    actors_pool->thread_collected = 0;
+
+    actors_pool->actors_queue = (actor_queue_t *) malloc(sizeof(actor_queue_t));
+    queue_init(actors_pool->actors_queue);
+    actors_pool->urgent_queue = (actor_queue_t *) malloc(sizeof(actor_queue_t));
+    queue_init(actors_pool->urgent_queue);
+
+    int error_code;
+
+    error_code = pthread_mutex_init(&actors_pool->mutex, NULL);
+    assert(error_code == 0);
+
+    // Timed sends measure their deadlines on monotonic clock.
+    pthread_condattr_t space_attr;
+    error_code = pthread_condattr_init(&space_attr);
+    assert(error_code == 0);
+    error_code = pthread_condattr_setclock(&space_attr, CLOCK_MONOTONIC);
+    assert(error_code == 0);
+    error_code = pthread_cond_init(&actors_pool->wait_for_space, &space_attr);
+    assert(error_code == 0);
+    pthread_condattr_destroy(&space_attr);
+
+    for (size_t thread = 0; thread < actors_pool->pool_size; ++thread) {
+        worker_t *worker = &actors_pool->workers[thread];
+
+        atomic_init(&worker->top, 0);
+        atomic_init(&worker->bottom, 0);
+        atomic_init(&worker->array, NULL);
+        worker->index = thread;
+        worker->system = actors_pool;
+        worker->cpu = worker_cpu(config, thread);
+        worker->node = 0;
+        worker->searches = 0;
+        atomic_init(&worker->dispatches, 0);
+        atomic_init(&worker->dispatched_messages, 0);
+        atomic_init(&worker->idle_ns, 0);
+        atomic_init(&worker->lock_wait_ns, 0);
+        atomic_init(&worker->inbox, NULL);
+        atomic_init(&worker->parked, WORKER_AWAKE);
+        atomic_init(&worker->inbox_since, 0);
+        atomic_init(&worker->inbox_size, 0);
+        atomic_init(&worker->busy, false);
+        worker->spare_rings = NULL;
+        worker->spare_count = 0;
+    }
+
+    timer_wheel_init();
+    blocking_pool_init(config->blocking_threads > 0 ? config->blocking_threads
+                       : BLOCKING_POOL_LIMIT);
+
+    error_code = pthread_barrier_init(&actors_pool->workers_ready, NULL,
+                                      actors_pool->pool_size + 1);
+    assert(error_code == 0);
+
+    // Creating threads with default attr.
+    for (size_t thread = 0; thread < actors_pool->pool_size; ++thread) {
+        worker_t *worker = &actors_pool->workers[thread];
+
+        error_code = pthread_create(&worker->thread, NULL, thread_loop, worker);
+        assert(error_code == 0);
+    }
+
+    // Deques are stolen from, so all have to exist before first actor.
+    pthread_barrier_wait(&actors_pool->workers_ready);
+
+    return 0;
+}
+
+// Returns CPU for thread, -1 if it should not be pinned.
+// Without explicit list threads take CPUs process may run on in turn.
+static int worker_cpu(const cacti_config_t *config, size_t thread) {
+    if (config->ncpus > 0) {
+        return config->cpus[thread % config->ncpus];
+    }
+    if (!config->pin_threads) {
+        return -1;
+    }
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0
+        || CPU_COUNT(&allowed) == 0) {
+        return -1;
+    }
+
+    size_t skip = thread % (size_t) CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed) && skip-- == 0) {
+            return cpu;
+        }
+    }
+
+    return -1;
+}
+
+// Pins thread and allocates its memory from it.
+// Failed pinning leaves thread where scheduler puts it.
+static void worker_start(worker_t *worker) {
+    if (worker->cpu >= 0 && worker->cpu < CPU_SETSIZE) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(worker->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            worker->cpu = -1;
+        }
+    }
+    else {
+        worker->cpu = -1;
+    }
+
+    // Single node machines and old kernels report node 0.
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+        worker->node = (int) node;
+    }
+
+    atomic_store(&worker->array, deque_array_create(DEQUE_INITIAL_CAPACITY));
+    trace_ring_init(&worker->trace, actors_pool->trace_events);
+
+    pthread_barrier_wait(&actors_pool->workers_ready);
+}
+
+static void destroy_actors_system() {
+    int error_code;
+
+    // Collect threads.
+    for (; actors_pool->thread_collected < actors_pool->pool_size;
+           ++actors_pool->thread_collected) {
+        void *thread_result;
+        error_code = pthread_join(
+                actors_pool->workers[actors_pool->thread_collected].thread,
+                &thread_result);
+        assert(error_code == 0);
+    }
+
+    // Handlers can not add timers anymore and all actors are dead,
+    // so timer thread has nothing left to send.
+    timer_wheel_destroy();
+    blocking_pool_destroy();
+
+    // All threads are done, so trace is complete.
+    if (actors_pool->trace_path != NULL) {
+        trace_write(actors_pool->trace_path);
+    }
+
+    for (size_t thread = 0; thread < actors_pool->pool_size; ++thread) {
+        free(actors_pool->workers[thread].trace.events);
+    }
+    free(actors_pool->trace_external.events);
+    free(actors_pool->trace_path);
+
+    for (size_t thread = 0; thread < actors_pool->pool_size; ++thread) {
+        deque_array_t *array = actors_pool->workers[thread].array;
+
+        while (array != NULL) {
+            deque_array_t *previous = array->previous;
+            free(array);
+            array = previous;
+        }
+    }
+
+    error_code = pthread_cond_destroy(&actors_pool->wait_for_space);
+    assert(error_code == 0);
+
+    error_code = pthread_barrier_destroy(&actors_pool->workers_ready);
+    assert(error_code == 0);
+
+    error_code = pthread_mutex_destroy(&actors_pool->mutex);
+    assert(error_code == 0);
+
+    // Free memory allocated for actors not reclaimed yet.
+    for (size_t slot = 0; slot < actors_pool->first_empty; ++slot) {
+        actor_t *actor = get_slot(slot)->actor;
+
+        if (actor != NULL) {
+            clear_actor(actor);
+        }
+    }
+
+    for (size_t slot = 0; slot < actors_pool->first_empty;
+         slot += ACTOR_CHUNK_SIZE) {
+        free(actors_pool->actors_data[slot / ACTOR_CHUNK_SIZE]);
+    }
+
+    for (size_t group = 0; group < actors_pool->groups_count; ++group) {
+        group_destroy(actors_pool->groups[group]);
+    }
+    free(actors_pool->groups);
+
+    free(actors_pool->actors_queue->actors);
+    free(actors_pool->actors_queue);
+    free(actors_pool->urgent_queue->actors);
+    free(actors_pool->urgent_queue);
+    free(actors_pool->actors_data);
+    free(actors_pool->workers);
+
+    unregister_system(actors_pool);
+    if (default_system == actors_pool) {
+        default_system = NULL;
+    }
+    free(actors_pool);
+    actors_pool = NULL;
+}
+
+// Returns false if actor can not be created.
+static bool add_actor(actor_id_t *actor_id, role_t *const role) {
+    return add_actors(actor_id, role, 1) == 1;
+}
+
+// Creates up to count actors under one lock. Returns number of created
+// actors, fewer if SIGINT was sent or there is no place for more.
+static size_t add_actors(actor_id_t *actor_ids, role_t *const role,
+                         size_t count) {
+    size_t added = 0;
+
+    lock_mutex();
+    for (; added < count; ++added) {
+        size_t first_empty = atomic_load_explicit(&actors_pool->first_empty,
+                                                  memory_order_relaxed);
+
+        // SIGINT was sent or there is no place for new actor.
+        if (actors_pool->got_sigint
+            || (actors_pool->free_slots == NO_FREE_SLOT
+                && first_empty == actors_pool->cast_limit)) {
+            break;
+        }
+
+        // Reuse slot of reclaimed actor if possible.
+        size_t index;
+        actor_slot_t *slot;
+
+        if (actors_pool->free_slots != NO_FREE_SLOT) {
+            index = actors_pool->free_slots;
+            slot = get_slot(index);
+            actors_pool->free_slots = slot->next_free;
+        }
+        else {
+            index = first_empty;
+
+            if (index % ACTOR_CHUNK_SIZE == 0) {
+                // Published to senders together with first_empty.
+                atomic_store_explicit(
+                        &actors_pool->actors_data[index / ACTOR_CHUNK_SIZE],
+                        (actor_slot_t *) malloc(
+                                ACTOR_CHUNK_SIZE * sizeof(actor_slot_t)),
+                        memory_order_relaxed);
+            }
+
+            slot = get_slot(index);
+            atomic_init(&slot->generation, 0);
+            atomic_init(&slot->senders, 0);
+            atomic_init(&slot->space_waiters, 0);
+        }
+
+        actor_ids[added] = ACTOR_ID(atomic_load(&slot->generation), index);
+
+        actor_t *actor = (actor_t *) malloc(sizeof(actor_t));
+        actor->id = actor_ids[added];
+        atomic_init(&actor->is_dead, false);
+        atomic_init(&actor->in_queue, false);
+        mailbox_init(&actor->mailbox);
+        atomic_init(&actor->urgent, NULL);
+        actor->urgent_streak = 0;
+        atomic_init(&actor->priority, MSG_PRIORITY_NORMAL);
+        atomic_init(&actor->home, thread_worker != NULL ? thread_worker->index
+                                                        : NO_HOME);
+        actor->inbox_next = NULL;
+        actor->role = role;
+        actor->state = NULL;
+        atomic_init(&actor->parked, 0);
+        actor->parked_first = NULL;
+        actor->parked_last = NULL;
+        atomic_init(&actor->handled, 0);
+        atomic_init(&actor->send_failures, 0);
+
+        // Senders read actors_data without mutex.
+        actors_pool->living_actors++;
+        atomic_store_explicit(&slot->actor, actor, memory_order_release);
+        if (index == first_empty) {
+            atomic_store_explicit(&actors_pool->first_empty, first_empty + 1,
+                                  memory_order_release);
+        }
+    }
+    unlock_mutex();
+
+    if (actors_pool->tracing) {
+        for (size_t i = 0; i < added; ++i) {
+            trace_event(TRACE_SPAWN, actor_ids[i], MSG_SPAWN);
+        }
+    }
+
+    return added;
+}
+
+static void clear_actor(actor_t *actor) {
+    // Messages are stored by value, left ones are just dropped.
+    message_t message;
+    while (next_message(actor, &message)) {
+        message_release(&message);
+    }
+
+    while (actor->parked_first != NULL) {
+        parked_message_t *parked = actor->parked_first;
+        actor->parked_first = parked->next;
+        message_release(&parked->message);
+        free(parked);
+    }
+
+    mailbox_destroy(&actor->mailbox);
+
+    mailbox_t *urgent = atomic_load(&actor->urgent);
+    if (urgent != NULL) {
+        mailbox_destroy(urgent);
+        free(urgent);
+    }
+    free(actor);
+}
+
+// Returns registry slot with given index, lower than first_empty.
+static actor_slot_t *get_slot(size_t index) {
+    actor_slot_t *chunk = atomic_load_explicit(
+            &actors_pool->actors_data[index / ACTOR_CHUNK_SIZE],
+            memory_order_acquire);
+
+    return &chunk[index % ACTOR_CHUNK_SIZE];
+}
+
+// Returns actor with given id. Caller has to own actor's in_queue flag.
+static actor_t *get_actor(actor_id_t actor_id) {
+    return atomic_load_explicit(&get_slot(ACTOR_INDEX(actor_id))->actor,
+                                memory_order_acquire);
+}
+
+static void wait_for_senders(actor_slot_t *slot) {
+    while (atomic_load(&slot->senders) > 0) {
+        sched_yield();
+    }
+}
+
+// Frees dead actor with empty mailbox and gives its slot for reuse.
+// Returns false if some messages were accepted before actor died.
+// Caller has to own actor's in_queue flag.
+static bool reclaim_actor(actor_t *actor) {
+    actor_slot_t *slot = get_slot(ACTOR_INDEX(actor->id));
+
+    // Senders coming after is_dead was set give up, wait for the others.
+    wait_for_senders(slot);
+
+    if (has_messages(actor) || actor->parked > 0) {
+        return false;
+    }
+
+    // Senders may still be looking at actor, wait until they see it's gone.
+    atomic_store(&slot->actor, NULL);
+    wait_for_senders(slot);
+
+    lock_mutex();
+    atomic_store(&slot->generation,
+                 (ACTOR_GENERATION(actor->id) + 1) & ACTOR_GENERATION_MASK);
+    slot->next_free = actors_pool->free_slots;
+    actors_pool->free_slots = ACTOR_INDEX(actor->id);
+    unlock_mutex();
+
+    clear_actor(actor);
+
+    return true;
+}
+
+// Performs first message of given actor.
+void perform_message(actor_t *current_actor, message_t *message) {
+    if (message->message_type == MSG_SPAWN) {
+        // Data field is the new role.
+        actor_id_t new_actor;
+
+        if (add_actor(&new_actor, message->data)) {
+            message_t new_message = {
+                    .message_type = MSG_HELLO,
+                    .nbytes = sizeof(actor_id_t),
+                    .data = (void *) current_actor->id
+            };
+
+            // Sends hello message to new actor.
+            send_message(new_actor, new_message);
+        }
+    }
+    else if (message->message_type == MSG_GODIE) {
+        TRACE(TRACE_GODIE, current_actor->id, MSG_GODIE);
+
+        if (!atomic_exchange(&current_actor->is_dead, true)) {
+            actors_pool->living_actors--;
+        }
+    }
+    else {
+        TRACE(TRACE_HANDLER_BEGIN, current_actor->id, message->message_type);
+
+        size_t nbytes = message->nbytes;
+        void *data = message->data;
+        if (message->buf != NULL) {
+            nbytes = message->buf->nbytes;
+            data = message->buf->data;
+        }
+        else if (message->is_inline) {
+            data = message->inline_data;
+        }
+
+        current_actor->role->prompts[message->message_type](
+                &current_actor->state, nbytes, data);
+
+        TRACE(TRACE_HANDLER_END, current_actor->id, message->message_type);
+    }
+
+    message_release(message);
+}
+
+// Gives actor back and requeues it if new messages have arrived.
+// Mailbox is shrunk first, as only owner can touch its segments.
+static void release_actor(actor_t *actor) {
+    if (actor->parked > 0) {
+        unpark_messages(actor);
+    }
+
+    if (next_lane(actor) == NULL) {
+        if (actor->is_dead && reclaim_actor(actor)) {
+            return;
+        }
+
+        mailbox_shrink(&actor->mailbox);
+
+        mailbox_t *urgent = atomic_load(&actor->urgent);
+        if (urgent != NULL) {
+            mailbox_shrink(urgent);
+        }
+    }
+
+    // Next owner could reclaim actor while it is checked here.
+    actor_slot_t *slot = get_slot(ACTOR_INDEX(actor->id));
+    atomic_fetch_add(&slot->senders, 1);
+
+    atomic_store(&actor->in_queue, false);
+    if (has_messages(actor) || actor->parked > 0) {
+        schedule_actor(actor);
+    }
+
+    atomic_fetch_sub(&slot->senders, 1);
+}
+
+// Performs up to batch messages of actor taken from queue,
+// then gives it back so other actors get their turn.
+static void perform_actor(actor_id_t actor_id) {
+    actor_t *current_actor = get_actor(actor_id);
+    size_t batch = current_actor->role->batch > 0
+                   ? current_actor->role->batch : actors_pool->batch;
+    size_t performed = 0;
+    bool handed_over = false;
+
+    thread_actor_id = actor_id;
+    thread_actor = current_actor;
+
+    // Stolen actor moves to thief.
+    if (thread_worker != NULL) {
+        atomic_store_explicit(&current_actor->home, thread_worker->index,
+                              memory_order_relaxed);
+    }
+
+    message_t message;
+    // Mailbox may look empty when sender has reserved slot but not yet
+    // published message, it will schedule actor again after publishing.
+    while (performed < batch) {
+        // Pool thread gives actor with blocking message to blocking pool.
+        if (thread_worker != NULL && blocking_next(current_actor)) {
+            handed_over = true;
+            break;
+        }
+
+        if (!next_message(current_actor, &message)) {
+            break;
+        }
+
+        TRACE(TRACE_DEQUEUE, actor_id, message.message_type);
+        perform_message(current_actor, &message);
+        performed++;
+    }
+
+    thread_actor_id = -1;
+    thread_actor = NULL;
+
+    if (performed > 0) {
+        notify_space(current_actor);
+    }
+
+    atomic_fetch_add_explicit(&current_actor->handled, performed,
+                              memory_order_relaxed);
+
+    if (thread_worker != NULL) {
+        atomic_fetch_add_explicit(&thread_worker->dispatches, 1,
+                                  memory_order_relaxed);
+        atomic_fetch_add_explicit(&thread_worker->dispatched_messages,
+                                  performed, memory_order_relaxed);
+    }
+
+    // Blocking pool releases actor when it is done with it.
+    if (handed_over) {
+        blocking_pool_add(actor_id);
+    }
+    else {
+        release_actor(current_actor);
+    }
+
+    if (performed > 0) {
+        messages_done(performed);
+    }
+}
+
+// Thread work loop.
+static void *thread_loop(void *d) {
+    thread_worker = (worker_t *) d;
+    actors_pool = thread_worker->system;
+    system_chosen = true;
+    worker_start(thread_worker);
+
+    // Number of failed searches since thread last performed actor.
+    size_t idle = 0;
+
+    // Keep working if any actor is alive
+    // or some messages had been added before all actors died.
+    while (thread_keep_working()) {
+        actor_id_t current_actor_id = find_actor(thread_worker);
+
+        if (current_actor_id != DEQUE_EMPTY) {
+            idle = 0;
+
+            // Pairs with fence in schedule_actor: actors pushed to inbox
+            // before thread got busy would wait for it, so others are woken.
+            atomic_store(&thread_worker->busy, true);
+            if (atomic_load(&thread_worker->inbox) != NULL) {
+                wake_worker();
+            }
+
+            perform_actor(current_actor_id);
+            atomic_store_explicit(&thread_worker->busy, false,
+                                  memory_order_relaxed);
+        }
+        else if (idle < actors_pool->idle_spins) {
+            // Actor may show up in a moment, parking would only delay it.
+            idle++;
+            cpu_relax();
+        }
+        else if (idle < actors_pool->idle_spins + actors_pool->idle_yields) {
+            idle++;
+            sched_yield();
+        }
+        else {
+            // Sleep when there are no actors.
+            idle = 0;
+            wait_for_actor();
+        }
+    }
+
+    // Job here is done, wake other threads.
+    wake_all_workers();
+
+    while (thread_worker->spare_rings != NULL) {
+        mailbox_segment_t *segment = thread_worker->spare_rings;
+        thread_worker->spare_rings = segment->retired;
+        free(segment);
+    }
+
+    thread_worker = NULL;
+    return NULL;
+}
+
+// Returns current actor's id.
+actor_id_t actor_id_self() {
+    assert(thread_actor_id != -1);
+    return thread_actor_id;
+}
+
+int actor_system_create(actor_id_t *actor, role_t *const role) {
+    const cacti_config_t config = {
+            .threads = POOL_SIZE,
+            .mailbox_limit = ACTOR_QUEUE_LIMIT,
+            .parked_limit = PARKED_LIMIT,
+            .cast_limit = CAST_LIMIT,
+            .batch = MESSAGE_BATCH
+    };
+
+    return actor_system_create_ex(actor, role, &config);
+}
+
+int actor_system_create_ex(actor_id_t *actor, role_t *const role,
+                           const cacti_config_t *config) {
+    if (default_system != NULL) {
+        return -1;
+    }
+
+    cacti_system_t *system = cacti_system_create(actor, role, config);
+    if (system == NULL) {
+        return -1;
+    }
+
+    default_system = system;
+    return 0;
+}
+
+cacti_system_t *cacti_system_create(actor_id_t *actor, role_t *const role,
+                                    const cacti_config_t *config) {
+    system_scope_t scope;
+    enter_system(NULL, &scope);
+
+    const cacti_config_t default_config = {0};
+    if (init_actors_system(config != NULL ? config : &default_config) != 0) {
+        leave_system(&scope);
+        return NULL;
+    }
+
+    set_sigint_handler();
+
+    bool created = add_actor(actor, role);
+    assert(created);
+
+    actors_pool->living_actors--; // Undo fake actor.
+
+    int error_code = send_message(*actor, (message_t) {
+            .message_type = MSG_HELLO,
+            .nbytes = sizeof(actor_id_t),
+            .data = (void *) *actor,
+    });
+    assert(error_code == 0);
+
+    cacti_system_t *system = actors_pool;
+    leave_system(&scope);
+
+    return system;
+}
+
+void cacti_system_join(cacti_system_t *system, actor_id_t actor) {
+    if (system == NULL) {
+        return;
+    }
+
+    system_scope_t scope;
+    enter_system(system, &scope);
+    actor_system_join(actor);
+
+    // Thread which chose joined system goes back to default one.
+    if (scope.system == system) {
+        scope.system = NULL;
+        scope.chosen = false;
+    }
+    leave_system(&scope);
+}
+
+void cacti_system_use(cacti_system_t *system) {
+    actors_pool = system;
+    system_chosen = system != NULL;
+}
+
+cacti_system_t *cacti_system_current() {
+    return current_system();
+}
+
+int cacti_send_message(cacti_system_t *system, actor_id_t actor,
+                       message_t message) {
+    if (system == NULL) {
+        return -2;
+    }
+
+    system_scope_t scope;
+    enter_system(system, &scope);
+    int result = send_message(actor, message);
+    leave_system(&scope);
+
+    return result;
+}
+
+int actor_system_dispatch_stats(size_t *dispatches, size_t *messages) {
+    if (current_system() == NULL) {
+        return -1;
+    }
+
+    *dispatches = 0;
+    *messages = 0;
+    for (size_t thread = 0; thread < actors_pool->pool_size; ++thread) {
+        worker_t *worker = &actors_pool->workers[thread];
+
+        *dispatches += atomic_load_explicit(&worker->dispatches,
+                                            memory_order_relaxed);
+        *messages += atomic_load_explicit(&worker->dispatched_messages,
+                                          memory_order_relaxed);
+    }
+
+    return 0;
+}
+
+void actor_system_join(actor_id_t actor) {
+    if (current_system() == NULL || actor < 0
+        || ACTOR_INDEX(actor) >= actors_pool->first_empty) {
+        return;
+    }
+
+    destroy_actors_system();
+}
+
+// Creates actors with one registry operation and says hello to each,
+// new actors start in spawning thread's queue.
+long spawn_actors(role_t *const role, size_t n, void *const init_data[],
+                  actor_id_t ids[]) {
+    if (current_system() == NULL) {
+        return -1;
+    }
+
+    actor_id_t *created = ids != NULL
+                          ? ids : (actor_id_t *) malloc(n * sizeof(actor_id_t));
+    size_t added = add_actors(created, role, n);
+
+    for (size_t i = 0; i < added; ++i) {
+        message_t hello = {
+                .message_type = MSG_HELLO,
+                .nbytes = sizeof(void *),
+                .data = init_data != NULL ? init_data[i]
+                                          : (void *) thread_actor_id
+        };
+
+        // Mailbox of new actor is empty, so hello always fits.
+        int error_code = push_message(created[i], &hello, false);
+        assert(error_code == 0);
+        (void) error_code;
+    }
+
+    if (ids == NULL) {
+        free(created);
+    }
+
+    return (long) added;
+}
+
+// Puts message sent from handler to full mailbox on actor's parked list.
+// Message is already counted in messages_in_system.
+// Returns false if parked_limit messages are already parked.
+// Caller has to keep actor from being reclaimed.
+static bool park_message(actor_t *actor, const message_t *message) {
+    parked_message_t *parked =
+            (parked_message_t *) malloc(sizeof(parked_message_t));
+    parked->message = *message;
+    parked->next = NULL;
+
+    lock_mutex();
+    if (actor->parked >= actors_pool->parked_limit) {
+        unlock_mutex();
+        free(parked);
+        return false;
+    }
+
+    if (actor->parked_last != NULL) {
+        actor->parked_last->next = parked;
+    }
+    else {
+        actor->parked_first = parked;
+    }
+    actor->parked_last = parked;
+    actor->parked++;
+    unlock_mutex();
+
+    // Owner unparks messages when giving actor back.
+    schedule_actor(actor);
+
+    return true;
+}
+
+// Moves parked messages to mailbox while there is space.
+// Caller has to own actor's in_queue flag.
+static void unpark_messages(actor_t *actor) {
+    lock_mutex();
+    while (actor->parked_first != NULL
+           && add_message(message_lane(actor, &actor->parked_first->message),
+                          &actor->parked_first->message)) {
+        parked_message_t *parked = actor->parked_first;
+        actor->parked_first = parked->next;
+        free(parked);
+        actor->parked--;
+    }
+
+    if (actor->parked_first == NULL) {
+        actor->parked_last = NULL;
+    }
+    unlock_mutex();
+}
+
+// Wakes senders waiting for space in actor's mailbox.
+// Pairs with space_waiters increment in send_message_until.
+static void notify_space(actor_t *actor) {
+    actor_slot_t *slot = get_slot(ACTOR_INDEX(actor->id));
+
+    if (atomic_load(&slot->space_waiters) > 0) {
+        lock_mutex();
+        int error_code = pthread_cond_broadcast(&actors_pool->wait_for_space);
+        assert(error_code == 0);
+        unlock_mutex();
+    }
+}
+
+// Finds living actor and keeps it from being reclaimed until unpinned.
+// Returns NULL and sets result to -1 if actor is dead
+// or to -2 if it was never created.
+static actor_t *pin_actor(actor_id_t actor, int *result) {
+    if (actor < 0 || ACTOR_INDEX(actor) >= atomic_load_explicit(
+            &actors_pool->first_empty, memory_order_acquire)) {
+        *result = -2;
+        return NULL;
+    }
+
+    actor_slot_t *slot = get_slot(ACTOR_INDEX(actor));
+    atomic_fetch_add(&slot->senders, 1);
+
+    actor_t *receiving_actor = atomic_load(&slot->actor);
+    long generation = atomic_load(&slot->generation);
+
+    if (ACTOR_GENERATION(actor) > generation) {
+        // Such actor was never created.
+        *result = -2;
+    }
+    else if (ACTOR_GENERATION(actor) < generation || receiving_actor == NULL
+             || receiving_actor->is_dead) {
+        // Actor is dead or was already reclaimed.
+        *result = -1;
+    }
+    else {
+        *result = 0;
+        return receiving_actor;
+    }
+
+    atomic_fetch_sub(&slot->senders, 1);
+    return NULL;
+}
+
+static void unpin_actor(actor_id_t actor) {
+    atomic_fetch_sub(&get_slot(ACTOR_INDEX(actor))->senders, 1);
+}
+
+// Pushes message to actor's mailbox.
+// Returns SEND_FULL if mailbox is full, unless message can be parked.
+static int push_message(actor_id_t actor, const message_t *message,
+                        bool park) {
+    // SIGINT was sent.
+    if (actors_pool->got_sigint) {
+        return 0;
+    }
+
+    int result;
+    actor_t *receiving_actor = pin_actor(actor, &result);
+    if (receiving_actor == NULL) {
+        return result;
+    }
+
+    // Counted before pushing so threads can not finish
+    // while message is in mailbox.
+    actors_pool->messages_in_system++;
+    message_retain(message);
+
+    // Parked messages go first, later ones can not overtake them.
+    if (receiving_actor->parked == 0
+        && add_message(message_lane(receiving_actor, message), message)) {
+        TRACE(TRACE_ENQUEUE, actor, message->message_type);
+        schedule_actor(receiving_actor);
+    }
+    else if (!park || !park_message(receiving_actor, message)) {
+        message_release(message);
+        messages_done(1);
+        result = SEND_FULL;
+    }
+
+    unpin_actor(actor);
+
+    return result;
+}
+
+// Checks if lane of living actor's mailbox message goes to is full,
+// or if it has parked messages which go first.
+static bool mailbox_full(actor_id_t actor, const message_t *message) {
+    int result;
+    actor_t *receiving_actor = pin_actor(actor, &result);
+    if (receiving_actor == NULL) {
+        return false;
+    }
+
+    bool full = receiving_actor->parked > 0
+                || atomic_load(&message_lane(receiving_actor, message)->size)
+                   >= actors_pool->mailbox_limit;
+
+    unpin_actor(actor);
+
+    return full;
+}
+
+// Sends message, waiting for space in full mailbox until deadline.
+// NULL deadline means waiting as long as needed.
+static int send_message_until(actor_id_t actor, message_t message,
+                              const struct timespec *deadline) {
+    int result;
+
+    while ((result = push_message(actor, &message, false)) == SEND_FULL) {
+        actor_slot_t *slot = get_slot(ACTOR_INDEX(actor));
+        int error_code = 0;
+
+        lock_mutex();
+        atomic_fetch_add(&slot->space_waiters, 1);
+
+        // Checked again after registering, so space freed in between
+        // is not missed.
+        if (mailbox_full(actor, &message)) {
+            if (deadline == NULL) {
+                error_code = pthread_cond_wait(&actors_pool->wait_for_space,
+                                               &actors_pool->mutex);
+            }
+            else {
+                error_code = pthread_cond_timedwait(
+                        &actors_pool->wait_for_space, &actors_pool->mutex,
+                        deadline);
+            }
+        }
+
+        atomic_fetch_sub(&slot->space_waiters, 1);
+        unlock_mutex();
+
+        if (error_code == ETIMEDOUT) {
+            result = push_message(actor, &message, false);
+            break;
+        }
+        assert(error_code == 0);
+    }
+
+    return send_result(result);
+}
+
+// Reports full mailbox as -1 and counts failed send.
+static int send_result(int result) {
+    if (result == SEND_FULL) {
+        result = -1;
+    }
+    if (result < 0) {
+        count_send_failures(1);
+    }
+
+    return result;
+}
+
+// Sends message to certain actor.
+// Lock-free: message is pushed straight into receiver's mailbox.
+int send_message(actor_id_t actor, message_t message) {
+    if (current_system() == NULL) {
+        return -2;
+    }
+
+    return send_result(push_message(actor, &message, false));
+}
+
+// Pushes messages to actor's mailbox as long as they fit,
+// actor is scheduled once for all of them.
+long send_messages(actor_id_t actor, const message_t *messages, size_t count) {
+    if (current_system() == NULL) {
+        return -2;
+    }
+
+    // SIGINT was sent.
+    if (actors_pool->got_sigint) {
+        return (long) count;
+    }
+
+    int result;
+    actor_t *receiving_actor = pin_actor(actor, &result);
+    if (receiving_actor == NULL) {
+        count_send_failures(count);
+        return result;
+    }
+
+    actors_pool->messages_in_system += count;
+    for (size_t i = 0; i < count; ++i) {
+        message_retain(&messages[i]);
+    }
+
+    // Runs of messages of the same priority are added at once.
+    // Parked messages go first, like in push_message.
+    size_t accepted = 0;
+    while (accepted < count && receiving_actor->parked == 0) {
+        mailbox_t *lane = message_lane(receiving_actor, &messages[accepted]);
+        size_t run = 1;
+        while (accepted + run < count
+               && message_lane(receiving_actor, &messages[accepted + run])
+                  == lane) {
+            run++;
+        }
+
+        size_t added = add_messages(lane, messages + accepted, run);
+        accepted += added;
+        if (added < run) {
+            break;
+        }
+    }
+    if (actors_pool->tracing) {
+        for (size_t i = 0; i < accepted; ++i) {
+            trace_event(TRACE_ENQUEUE, actor, messages[i].message_type);
+        }
+    }
+    if (accepted > 0) {
+        schedule_actor(receiving_actor);
+    }
+    if (accepted < count) {
+        for (size_t i = accepted; i < count; ++i) {
+            message_release(&messages[i]);
+        }
+        messages_done(count - accepted);
+        count_send_failures(count - accepted);
+    }
+
+    unpin_actor(actor);
+
+    return (long) accepted;
+}
+
+// Sets scheduling priority of actor, used next time it becomes runnable.
+int actor_set_priority(actor_id_t actor, int priority) {
+    if (current_system() == NULL) {
+        return -2;
+    }
+
+    int result;
+    actor_t *target = pin_actor(actor, &result);
+    if (target == NULL) {
+        return result;
+    }
+
+    atomic_store(&target->priority, priority);
+    unpin_actor(actor);
+
+    return 0;
+}
+
+// Sends message, waiting for space if mailbox is full.
+// Handlers can not wait, as it could deadlock whole pool,
+// so their messages are parked and delivered when space frees.
+int send_message_blocking(actor_id_t actor, message_t message) {
+    if (current_system() == NULL) {
+        return -2;
+    }
+
+    if (thread_actor_id != -1) {
+        return send_result(push_message(actor, &message, true));
+    }
+
+    return send_message_until(actor, message, NULL);
+}
+
+// Sends message, waiting at most timeout_us microseconds for space.
+// Handlers park message instead, like in send_message_blocking.
+int send_message_timed(actor_id_t actor, message_t message, long timeout_us) {
+    if (current_system() == NULL) {
+        return -2;
+    }
+
+    if (thread_actor_id != -1) {
+        return send_result(push_message(actor, &message, true));
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    deadline.tv_sec += timeout_us / 1000000;
+    deadline.tv_nsec += (timeout_us % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    return send_message_until(actor, message, &deadline);
+}
+
+// Returns NULL if there is no such group in current system.
+static group_t *get_group(group_id_t group) {
+    if (current_system() == NULL || group < 0 || group >= GROUP_LIMIT) {
+        return NULL;
+    }
+
+    return atomic_load_explicit(&actors_pool->groups[group],
+                                memory_order_acquire);
+}
+
+static group_members_t *group_members_create(size_t capacity) {
+    group_members_t *members = (group_members_t *) malloc(
+            sizeof(group_members_t) + capacity * sizeof(atomic_long));
+
+    members->capacity = capacity;
+    atomic_init(&members->count, 0);
+    atomic_init(&members->removed, 0);
+    members->retired = NULL;
+
+    return members;
+}
+
+// Replaces group's members with copy without empty entries.
+// Old array is freed once no sender reads it.
+// Caller has to hold group's mutex.
+static void group_compact(group_t *group, size_t capacity) {
+    group_members_t *old = atomic_load(&group->members);
+    group_members_t *members = group_members_create(capacity);
+
+    size_t count = 0;
+    for (size_t i = 0; i < atomic_load(&old->count); ++i) {
+        actor_id_t actor = atomic_load(&old->actors[i]);
+
+        if (actor != NO_MEMBER) {
+            atomic_init(&members->actors[count++], actor);
+        }
+    }
+    atomic_init(&members->count, count);
+
+    atomic_store(&group->members, members);
+
+    old->retired = group->retired;
+    group->retired = old;
+
+    // Senders coming later see only new array.
+    if (atomic_load(&group->senders) == 0) {
+        while (group->retired != NULL) {
+            group_members_t *retired = group->retired;
+            group->retired = retired->retired;
+            free(retired);
+        }
+    }
+}
+
+static void group_destroy(group_t *group) {
+    while (group->retired != NULL) {
+        group_members_t *retired = group->retired;
+        group->retired = retired->retired;
+        free(retired);
+    }
+
+    int error_code = pthread_mutex_destroy(&group->mutex);
+    assert(error_code == 0);
+
+    free(group->members);
+    free(group->name);
+    free(group);
+}
+
+// Creates group with given name or returns existing one.
+group_id_t group_create(const char *name) {
+    group_id_t result = -1;
+    if (current_system() == NULL) {
+        return result;
+    }
+
+    lock_mutex();
+    for (size_t group = 0; group < actors_pool->groups_count; ++group) {
+        if (strcmp(actors_pool->groups[group]->name, name) == 0) {
+            result = (group_id_t) group;
+        }
+    }
+
+    if (result == -1 && actors_pool->groups_count < GROUP_LIMIT) {
+        group_t *group = (group_t *) malloc(sizeof(group_t));
+
+        group->name = strdup(name);
+        int error_code = pthread_mutex_init(&group->mutex, NULL);
+        assert(error_code == 0);
+        atomic_init(&group->members, group_members_create(GROUP_MIN_CAPACITY));
+        group->retired = NULL;
+        atomic_init(&group->senders, 0);
+
+        result = (group_id_t) actors_pool->groups_count++;
+        atomic_store_explicit(&actors_pool->groups[result], group,
+                              memory_order_release);
+    }
+    unlock_mutex();
+
+    return result;
+}
+
+// Adds actor at the end of group's members.
+int group_join(group_id_t group, actor_id_t actor) {
+    group_t *joined = get_group(group);
+    if (joined == NULL) {
+        return -2;
+    }
+
+    int result;
+    if (pin_actor(actor, &result) == NULL) {
+        return result;
+    }
+    unpin_actor(actor);
+
+    int error_code = pthread_mutex_lock(&joined->mutex);
+    assert(error_code == 0);
+
+    group_members_t *members = atomic_load(&joined->members);
+    size_t count = atomic_load(&members->count);
+
+    if (count == members->capacity) {
+        size_t living = count - atomic_load(&members->removed);
+        size_t capacity = GROUP_MIN_CAPACITY;
+        while (capacity <= 2 * living) {
+            capacity *= 2;
+        }
+
+        group_compact(joined, capacity);
+        members = atomic_load(&joined->members);
+        count = atomic_load(&members->count);
+    }
+
+    // Published after entry is written.
+    atomic_store_explicit(&members->actors[count], actor,
+                          memory_order_relaxed);
+    atomic_store_explicit(&members->count, count + 1, memory_order_release);
+
+    error_code = pthread_mutex_unlock(&joined->mutex);
+    assert(error_code == 0);
+
+    return 0;
+}
+
+// Removes one entry of actor from group.
+int group_leave(group_id_t group, actor_id_t actor) {
+    group_t *left = get_group(group);
+    if (left == NULL) {
+        return -2;
+    }
+
+    int result = -1;
+
+    int error_code = pthread_mutex_lock(&left->mutex);
+    assert(error_code == 0);
+
+    group_members_t *members = atomic_load(&left->members);
+    size_t count = atomic_load(&members->count);
+
+    for (size_t i = 0; i < count; ++i) {
+        actor_id_t member = actor;
+
+        // Entry could be emptied by sender which found actor dead.
+        if (atomic_compare_exchange_strong(&members->actors[i], &member,
+                                           NO_MEMBER)) {
+            atomic_fetch_add(&members->removed, 1);
+            result = 0;
+            break;
+        }
+    }
+
+    // Mostly empty array is not worth walking through.
+    size_t removed = atomic_load(&members->removed);
+    if (2 * removed > count && members->capacity > GROUP_MIN_CAPACITY) {
+        size_t capacity = GROUP_MIN_CAPACITY;
+        while (capacity <= 2 * (count - removed)) {
+            capacity *= 2;
+        }
+        group_compact(left, capacity);
+    }
+
+    error_code = pthread_mutex_unlock(&left->mutex);
+    assert(error_code == 0);
+
+    return result;
+}
+
+// Pushes message to every member of group in one pass over members.
+// Dead members are removed on the way.
+long send_group(group_id_t group, message_t message) {
+    group_t *receivers = get_group(group);
+    if (receivers == NULL) {
         return -2;
     }
 
-    actor_t *receiving_actor = actors_pool->actors_data[actor];
+    // SIGINT was sent.
+    if (actors_pool->got_sigint) {
+        return 0;
+    }
+
+    // Keeps members array from being freed until pass ends.
+    atomic_fetch_add(&receivers->senders, 1);
 
-    if (receiving_actor->is_dead
-        || receiving_actor->messages_queue->current_size == ACTOR_QUEUE_LIMIT) {
-        unlock_mutex();
+    group_members_t *members = atomic_load(&receivers->members);
+    size_t count = atomic_load_explicit(&members->count, memory_order_acquire);
+    long delivered = 0;
+    size_t failed = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        actor_id_t actor = atomic_load(&members->actors[i]);
+        if (actor == NO_MEMBER) {
+            continue;
+        }
+
+        int result = push_message(actor, &message, false);
+        if (result == 0) {
+            delivered++;
+            continue;
+        }
+
+        failed++;
+        if (result == -1
+            && atomic_compare_exchange_strong(&members->actors[i], &actor,
+                                              NO_MEMBER)) {
+            atomic_fetch_add(&members->removed, 1);
+        }
+    }
+
+    atomic_fetch_sub(&receivers->senders, 1);
+
+    // Skipped members count as failed sends, like send_message's -1.
+    if (failed > 0) {
+        count_send_failures(failed);
+    }
+
+    return delivered;
+}
+
+int cacti_stats_snapshot(cacti_stats_t *stats) {
+    if (current_system() == NULL) {
         return -1;
     }
 
-    add_message(actor, receiving_actor->messages_queue, copy_message(message));
+    stats->living_actors = atomic_load_explicit(&actors_pool->living_actors,
+                                                memory_order_relaxed);
+    stats->messages_in_system = atomic_load_explicit(
+            &actors_pool->messages_in_system, memory_order_relaxed);
+    stats->send_failures = atomic_load_explicit(&actors_pool->send_failures,
+                                                memory_order_relaxed);
+    stats->run_queue = atomic_load_explicit(
+            &actors_pool->actors_queue->current_size, memory_order_relaxed)
+            + atomic_load_explicit(&actors_pool->urgent_queue->current_size,
+                                   memory_order_relaxed)
+            + atomic_load_explicit(&actors_pool->blocking->queue.current_size,
+                                   memory_order_relaxed);
+
+    stats->nworkers = actors_pool->pool_size;
+    stats->workers = (cacti_worker_stats_t *) malloc(
+            stats->nworkers * sizeof(cacti_worker_stats_t));
+
+    for (size_t thread = 0; thread < actors_pool->pool_size; ++thread) {
+        worker_t *worker = &actors_pool->workers[thread];
+        long queued = atomic_load_explicit(&worker->bottom,
+                                           memory_order_relaxed)
+                      - atomic_load_explicit(&worker->top,
+                                             memory_order_relaxed);
+
+        stats->run_queue += queued > 0 ? (size_t) queued : 0;
+        stats->run_queue += atomic_load_explicit(&worker->inbox_size,
+                                                 memory_order_relaxed);
+        stats->workers[thread] = (cacti_worker_stats_t) {
+                .dispatches = atomic_load_explicit(&worker->dispatches,
+                                                   memory_order_relaxed),
+                .messages = atomic_load_explicit(&worker->dispatched_messages,
+                                                 memory_order_relaxed),
+                .idle_ns = atomic_load_explicit(&worker->idle_ns,
+                                                memory_order_relaxed),
+                .lock_wait_ns = atomic_load_explicit(&worker->lock_wait_ns,
+                                                     memory_order_relaxed),
+                .cpu = worker->cpu,
+                .node = worker->node
+        };
+    }
 
-    unlock_mutex();
+    size_t first_empty = atomic_load_explicit(&actors_pool->first_empty,
+                                              memory_order_acquire);
+    stats->nactors = 0;
+    stats->actors = (cacti_actor_stats_t *) malloc(
+            first_empty * sizeof(cacti_actor_stats_t));
+
+    for (size_t index = 0; index < first_empty; ++index) {
+        actor_slot_t *slot = get_slot(index);
+
+        // Keeps actor from being reclaimed while it is read.
+        atomic_fetch_add(&slot->senders, 1);
+
+        actor_t *actor = atomic_load(&slot->actor);
+        if (actor != NULL && !actor->is_dead) {
+            mailbox_t *urgent = atomic_load_explicit(&actor->urgent,
+                                                     memory_order_acquire);
+            size_t urgent_high_water = urgent != NULL
+                    ? atomic_load_explicit(&urgent->high_water,
+                                           memory_order_relaxed)
+                    : 0;
+
+            stats->actors[stats->nactors++] = (cacti_actor_stats_t) {
+                    .id = actor->id,
+                    .messages = atomic_load_explicit(&actor->handled,
+                                                     memory_order_relaxed),
+                    .mailbox_depth = atomic_load_explicit(
+                            &actor->mailbox.size, memory_order_relaxed)
+                            + urgent_size(actor),
+                    .mailbox_high_water = atomic_load_explicit(
+                            &actor->mailbox.high_water, memory_order_relaxed)
+                            + urgent_high_water,
+                    .send_failures = atomic_load_explicit(
+                            &actor->send_failures, memory_order_relaxed)
+            };
+        }
+
+        atomic_fetch_sub(&slot->senders, 1);
+    }
+
+    return 0;
+}
+
+void cacti_stats_free(cacti_stats_t *stats) {
+    free(stats->workers);
+    free(stats->actors);
+    stats->workers = NULL;
+    stats->actors = NULL;
+}
+
+int cacti_trace_dump(const char *path) {
+    if (current_system() == NULL || !actors_pool->tracing) {
+        return -1;
+    }
+
+    return trace_write(path);
+}
+
+static void timer_wheel_init() {
+    timer_wheel_t *wheel = (timer_wheel_t *) malloc(sizeof(timer_wheel_t));
+    actors_pool->timers = wheel;
+
+    int error_code = pthread_mutex_init(&wheel->mutex, NULL);
+    assert(error_code == 0);
+
+    // Timer thread sleeps until ticks measured on monotonic clock.
+    pthread_condattr_t attr;
+    error_code = pthread_condattr_init(&attr);
+    assert(error_code == 0);
+    error_code = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    assert(error_code == 0);
+    error_code = pthread_cond_init(&wheel->wakeup, &attr);
+    assert(error_code == 0);
+    pthread_condattr_destroy(&attr);
+
+    wheel->stop = false;
+    wheel->pending = 0;
+    wheel->start = monotonic_ns();
+    wheel->current = 0;
+    wheel->sleeping_until = TIMER_NEVER;
+
+    for (size_t level = 0; level < TIMER_LEVELS; ++level) {
+        for (size_t slot = 0; slot < TIMER_SLOTS; ++slot) {
+            wheel->slots[level][slot] = (timer_list_t) {NULL, NULL};
+        }
+    }
+
+    error_code = pthread_create(&wheel->thread, NULL, timer_loop, actors_pool);
+    assert(error_code == 0);
+}
+
+// Stops timer thread and drops timers which have not expired.
+static void timer_wheel_destroy() {
+    timer_wheel_t *wheel = actors_pool->timers;
+
+    int error_code = pthread_mutex_lock(&wheel->mutex);
+    assert(error_code == 0);
+    wheel->stop = true;
+    error_code = pthread_cond_signal(&wheel->wakeup);
+    assert(error_code == 0);
+    error_code = pthread_mutex_unlock(&wheel->mutex);
+    assert(error_code == 0);
+
+    error_code = pthread_join(wheel->thread, NULL);
+    assert(error_code == 0);
+
+    for (size_t level = 0; level < TIMER_LEVELS; ++level) {
+        for (size_t slot = 0; slot < TIMER_SLOTS; ++slot) {
+            pending_timer_t *timer = wheel->slots[level][slot].first;
+
+            while (timer != NULL) {
+                pending_timer_t *next = timer->next;
+                message_release(&timer->message);
+                free(timer);
+                timer = next;
+            }
+        }
+    }
+
+    error_code = pthread_cond_destroy(&wheel->wakeup);
+    assert(error_code == 0);
+    error_code = pthread_mutex_destroy(&wheel->mutex);
+    assert(error_code == 0);
+
+    free(wheel);
+    actors_pool->timers = NULL;
+}
+
+// Number of ticks which have fully passed.
+static unsigned long long timer_now() {
+    return (monotonic_ns() - actors_pool->timers->start)
+           / (TIMER_TICK_US * 1000);
+}
+
+// Puts timer in slot of level covering its distance from current tick.
+// Caller has to hold wheel's mutex.
+static void timer_insert(pending_timer_t *timer) {
+    timer_wheel_t *wheel = actors_pool->timers;
+    unsigned long long expires = timer->expires;
+
+    if (expires < wheel->current) {
+        expires = wheel->current;
+    }
+
+    size_t level = 0;
+    unsigned long long distance = expires - wheel->current;
+    while (level < TIMER_LEVELS - 1
+           && distance >= (1ULL << (TIMER_BITS * (level + 1)))) {
+        level++;
+    }
+
+    // Too distant timer waits in last slot and is cascaded down again.
+    if (distance >= (1ULL << (TIMER_BITS * TIMER_LEVELS))) {
+        expires = wheel->current + (1ULL << (TIMER_BITS * TIMER_LEVELS)) - 1;
+    }
+
+    timer_list_t *list = &wheel->slots[level]
+            [(expires >> (TIMER_BITS * level)) & (TIMER_SLOTS - 1)];
+
+    timer->next = NULL;
+    if (list->last != NULL) {
+        list->last->next = timer;
+    }
+    else {
+        list->first = timer;
+    }
+    list->last = timer;
+
+    wheel->pending++;
+}
+
+// Moves timers of level's current slot to lower levels.
+// Returns index of that slot, 0 means level above has to be cascaded too.
+static size_t timer_cascade(size_t level) {
+    timer_wheel_t *wheel = actors_pool->timers;
+    size_t index = (wheel->current >> (TIMER_BITS * level)) & (TIMER_SLOTS - 1);
+    pending_timer_t *timer = wheel->slots[level][index].first;
+
+    wheel->slots[level][index] = (timer_list_t) {NULL, NULL};
+
+    while (timer != NULL) {
+        pending_timer_t *next = timer->next;
+        wheel->pending--;
+        timer_insert(timer);
+        timer = next;
+    }
+
+    return index;
+}
+
+// First tick at which timer thread has some work.
+static unsigned long long timer_next() {
+    timer_wheel_t *wheel = actors_pool->timers;
+
+    for (unsigned long long tick = wheel->current;; ++tick) {
+        size_t index = tick & (TIMER_SLOTS - 1);
+
+        if ((index == 0 && tick != wheel->current)
+            || wheel->slots[0][index].first != NULL) {
+            return tick;
+        }
+    }
+}
+
+// Timer thread loop. Expired timers are sent without holding mutex.
+static void *timer_loop(void *d) {
+    actors_pool = (actors_system_t *) d;
+    system_chosen = true;
+    timer_wheel_t *wheel = actors_pool->timers;
+
+    int error_code = pthread_mutex_lock(&wheel->mutex);
+    assert(error_code == 0);
+
+    while (!wheel->stop) {
+        if (wheel->pending == 0) {
+            wheel->sleeping_until = TIMER_NEVER;
+            error_code = pthread_cond_wait(&wheel->wakeup, &wheel->mutex);
+            assert(error_code == 0);
+            continue;
+        }
+
+        unsigned long long next = timer_next();
+        if (next > timer_now()) {
+            wheel->sleeping_until = next;
+            unsigned long long wake = wheel->start
+                                      + next * TIMER_TICK_US * 1000;
+            struct timespec deadline = {
+                    .tv_sec = (time_t) (wake / 1000000000),
+                    .tv_nsec = (long) (wake % 1000000000)
+            };
+
+            error_code = pthread_cond_timedwait(&wheel->wakeup, &wheel->mutex,
+                                                &deadline);
+            assert(error_code == 0 || error_code == ETIMEDOUT);
+            continue;
+        }
+
+        // Collect timers of all ticks which have passed.
+        timer_list_t expired = {NULL, NULL};
+        unsigned long long now = timer_now();
+
+        while (wheel->current <= now) {
+            size_t index = wheel->current & (TIMER_SLOTS - 1);
+
+            if (index == 0) {
+                for (size_t level = 1;
+                     level < TIMER_LEVELS && timer_cascade(level) == 0;
+                     ++level) {
+                }
+            }
+
+            timer_list_t *list = &wheel->slots[0][index];
+            if (list->first != NULL) {
+                if (expired.last != NULL) {
+                    expired.last->next = list->first;
+                }
+                else {
+                    expired.first = list->first;
+                }
+                expired.last = list->last;
+
+                for (pending_timer_t *timer = list->first; timer != NULL;
+                     timer = timer->next) {
+                    wheel->pending--;
+                }
+                *list = (timer_list_t) {NULL, NULL};
+            }
+
+            wheel->current++;
+        }
+
+        error_code = pthread_mutex_unlock(&wheel->mutex);
+        assert(error_code == 0);
+
+        // Full mailboxes get parked messages, so timers never block.
+        // Periodic timer skips tick when even parking fails, it ends
+        // only with its actor.
+        pending_timer_t *timer = expired.first;
+        pending_timer_t *periodic = NULL;
+        while (timer != NULL) {
+            pending_timer_t *next = timer->next;
+
+            int result = push_message(timer->actor, &timer->message, true);
+            if (result == SEND_FULL) {
+                count_send_failures(1);
+            }
+
+            if ((result == 0 || result == SEND_FULL) && timer->period > 0) {
+                timer->expires += timer->period;
+                timer->next = periodic;
+                periodic = timer;
+            }
+            else {
+                message_release(&timer->message);
+                free(timer);
+            }
+
+            timer = next;
+        }
+
+        error_code = pthread_mutex_lock(&wheel->mutex);
+        assert(error_code == 0);
+
+        while (periodic != NULL) {
+            pending_timer_t *next = periodic->next;
+            timer_insert(periodic);
+            periodic = next;
+        }
+    }
+
+    error_code = pthread_mutex_unlock(&wheel->mutex);
+    assert(error_code == 0);
+
+    return NULL;
+}
+
+static int add_timer(actor_id_t actor, message_t message, long delay_us,
+                     long period_us) {
+    if (current_system() == NULL) {
+        return -2;
+    }
+
+    int result;
+    if (pin_actor(actor, &result) == NULL) {
+        return result;
+    }
+    unpin_actor(actor);
+
+    timer_wheel_t *wheel = actors_pool->timers;
+    unsigned long long tick_ns = TIMER_TICK_US * 1000;
+
+    pending_timer_t *timer = (pending_timer_t *) malloc(sizeof(pending_timer_t));
+    timer->actor = actor;
+    timer->message = message;
+    message_retain(&message);
+
+    // Rounded up, so message is never sent too early.
+    timer->expires = (monotonic_ns() - wheel->start
+                      + (unsigned long long) delay_us * 1000 + tick_ns - 1)
+                     / tick_ns;
+    timer->period = period_us > 0
+                    ? ((unsigned long long) period_us + TIMER_TICK_US - 1)
+                      / TIMER_TICK_US
+                    : 0;
+
+    int error_code = pthread_mutex_lock(&wheel->mutex);
+    assert(error_code == 0);
+
+    // Idle wheel has not been moving its current tick.
+    if (wheel->pending == 0) {
+        unsigned long long now = timer_now();
+        if (wheel->current < now) {
+            wheel->current = now;
+        }
+    }
+
+    // Sleeping thread would notice timer due earlier only at its next tick.
+    if (timer->expires < wheel->sleeping_until) {
+        error_code = pthread_cond_signal(&wheel->wakeup);
+        assert(error_code == 0);
+    }
+    timer_insert(timer);
+
+    error_code = pthread_mutex_unlock(&wheel->mutex);
+    assert(error_code == 0);
+
+    return 0;
+}
+
+// Sends message after delay, no thread is occupied in between.
+int send_after(actor_id_t actor, message_t message, long delay_us) {
+    // Sent at once like by timer thread, full mailbox gets it parked.
+    if (delay_us <= 0) {
+        if (current_system() == NULL) {
+            return -2;
+        }
+
+        return send_result(push_message(actor, &message, true));
+    }
+
+    return add_timer(actor, message, delay_us, 0);
+}
+
+// Sends message every period until actor dies.
+int send_every(actor_id_t actor, message_t message, long period_us) {
+    if (period_us <= 0) {
+        period_us = TIMER_TICK_US;
+    }
+
+    return add_timer(actor, message, period_us, period_us);
+}
+
+static void blocking_pool_init(size_t limit) {
+    blocking_pool_t *pool = (blocking_pool_t *) malloc(sizeof(blocking_pool_t));
+    actors_pool->blocking = pool;
+
+    int error_code = pthread_mutex_init(&pool->mutex, NULL);
+    assert(error_code == 0);
+
+    // Idle threads time out on monotonic clock.
+    pthread_condattr_t attr;
+    error_code = pthread_condattr_init(&attr);
+    assert(error_code == 0);
+    error_code = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    assert(error_code == 0);
+    error_code = pthread_cond_init(&pool->wait_for_actor, &attr);
+    assert(error_code == 0);
+    pthread_condattr_destroy(&attr);
+
+    error_code = pthread_cond_init(&pool->all_done, NULL);
+    assert(error_code == 0);
+
+    queue_init(&pool->queue);
+
+    pool->threads = 0;
+    pool->idle = 0;
+    pool->limit = limit;
+    pool->stop = false;
+}
+
+// Waits until all threads of blocking pool end.
+static void blocking_pool_destroy() {
+    blocking_pool_t *pool = actors_pool->blocking;
+
+    int error_code = pthread_mutex_lock(&pool->mutex);
+    assert(error_code == 0);
+
+    pool->stop = true;
+    error_code = pthread_cond_broadcast(&pool->wait_for_actor);
+    assert(error_code == 0);
+
+    while (pool->threads > 0) {
+        error_code = pthread_cond_wait(&pool->all_done, &pool->mutex);
+        assert(error_code == 0);
+    }
+
+    error_code = pthread_mutex_unlock(&pool->mutex);
+    assert(error_code == 0);
+
+    error_code = pthread_cond_destroy(&pool->wait_for_actor);
+    assert(error_code == 0);
+    error_code = pthread_cond_destroy(&pool->all_done);
+    assert(error_code == 0);
+    error_code = pthread_mutex_destroy(&pool->mutex);
+    assert(error_code == 0);
+
+    free(pool->queue.actors);
+    free(pool);
+    actors_pool->blocking = NULL;
+}
+
+// Checks if first message of owned actor has to be performed
+// on blocking pool.
+static bool blocking_next(actor_t *actor) {
+    role_t *role = actor->role;
+
+    if (role->blocking) {
+        return true;
+    }
+    if (role->blocking_prompts == NULL) {
+        return false;
+    }
+
+    mailbox_t *lane = next_lane(actor);
+    if (lane == NULL) {
+        return false;
+    }
+
+    mailbox_slot_t *slot = mailbox_front(lane);
+
+    message_type_t type = slot->message.message_type;
+    return type >= 0 && (size_t) type < role->nprompts
+           && role->blocking_prompts[type];
+}
+
+// Hands owned actor over to blocking pool, starting new thread
+// if all are busy.
+static void blocking_pool_add(actor_id_t actor) {
+    blocking_pool_t *pool = actors_pool->blocking;
+
+    int error_code = pthread_mutex_lock(&pool->mutex);
+    assert(error_code == 0);
+
+    queue_add_actor(&pool->queue, actor);
+
+    if (pool->idle < pool->queue.current_size && pool->threads < pool->limit) {
+        pthread_t thread;
+        pthread_attr_t attr;
+
+        error_code = pthread_attr_init(&attr);
+        assert(error_code == 0);
+        error_code = pthread_attr_setdetachstate(&attr,
+                                                 PTHREAD_CREATE_DETACHED);
+        assert(error_code == 0);
+        error_code = pthread_create(&thread, &attr, blocking_loop,
+                                    actors_pool);
+        assert(error_code == 0);
+        pthread_attr_destroy(&attr);
+
+        pool->threads++;
+    }
+    else {
+        error_code = pthread_cond_signal(&pool->wait_for_actor);
+        assert(error_code == 0);
+    }
+
+    error_code = pthread_mutex_unlock(&pool->mutex);
+    assert(error_code == 0);
+}
+
+// Blocking pool thread loop. Actors performed here are released
+// as usual, so they go back to pool threads afterwards.
+static void *blocking_loop(void *d) {
+    actors_pool = (actors_system_t *) d;
+    system_chosen = true;
+    blocking_pool_t *pool = actors_pool->blocking;
+
+    int error_code = pthread_mutex_lock(&pool->mutex);
+    assert(error_code == 0);
+
+    while (true) {
+        if (pool->queue.current_size == 0) {
+            if (pool->stop) {
+                break;
+            }
+
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += BLOCKING_IDLE_US / 1000000;
+            deadline.tv_nsec += (BLOCKING_IDLE_US % 1000000) * 1000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+
+            pool->idle++;
+            error_code = pthread_cond_timedwait(&pool->wait_for_actor,
+                                                &pool->mutex, &deadline);
+            pool->idle--;
+            assert(error_code == 0 || error_code == ETIMEDOUT);
+
+            if (error_code == ETIMEDOUT && pool->queue.current_size == 0) {
+                break;
+            }
+            continue;
+        }
+
+        actor_id_t actor = queue_get_actor(&pool->queue);
+
+        error_code = pthread_mutex_unlock(&pool->mutex);
+        assert(error_code == 0);
+
+        perform_actor(actor);
+
+        error_code = pthread_mutex_lock(&pool->mutex);
+        assert(error_code == 0);
+    }
+
+    pool->threads--;
+    if (pool->threads == 0) {
+        error_code = pthread_cond_signal(&pool->all_done);
+        assert(error_code == 0);
+    }
+
+    error_code = pthread_mutex_unlock(&pool->mutex);
+    assert(error_code == 0);
+
+    return NULL;
+}
+
+int message_set_inline(message_t *message, const void *data, size_t nbytes) {
+    if (nbytes > MESSAGE_INLINE_BYTES) {
+        return -1;
+    }
+
+    memcpy(message->inline_data, data, nbytes);
+    message->nbytes = nbytes;
+    message->is_inline = true;
     return 0;
 }
+
+cacti_buf_t *cacti_buf_create(size_t nbytes) {
+    cacti_buf_t *buf = (cacti_buf_t *) malloc(sizeof(cacti_buf_t) + nbytes);
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    atomic_init(&buf->references, 1);
+    buf->nbytes = nbytes;
+    return buf;
+}
+
+void *cacti_buf_data(cacti_buf_t *buf) {
+    return buf->data;
+}
+
+size_t cacti_buf_size(cacti_buf_t *buf) {
+    return buf->nbytes;
+}
+
+cacti_buf_t *cacti_buf_of(void *data) {
+    return (cacti_buf_t *) ((unsigned char *) data
+                            - offsetof(cacti_buf_t, data));
+}
+
+void cacti_buf_retain(cacti_buf_t *buf) {
+    atomic_fetch_add_explicit(&buf->references, 1, memory_order_relaxed);
+}
+
+// Last reference frees buffer, acquire and release make writes of all
+// holders visible before that.
+void cacti_buf_release(cacti_buf_t *buf) {
+    if (atomic_fetch_sub_explicit(&buf->references, 1,
+                                  memory_order_acq_rel) == 1) {
+        free(buf);
+    }
+}
+
+size_t cacti_buf_references(cacti_buf_t *buf) {
+    return atomic_load_explicit(&buf->references, memory_order_acquire);
+}
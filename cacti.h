@@ -1,6 +1,7 @@
 #ifndef CACTI_H
 #define CACTI_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 typedef long message_type_t;
@@ -13,21 +14,124 @@ typedef long message_type_t;
 #define ACTOR_QUEUE_LIMIT 1024
 #endif
 
+// Messages handlers can park for one actor whose mailbox is full.
+#ifndef PARKED_LIMIT
+#define PARKED_LIMIT 65536
+#endif
+
 #ifndef CAST_LIMIT
 #define CAST_LIMIT 1048576
 #endif
 
+// Maximal number of actor systems living at once.
+#ifndef SYSTEM_LIMIT
+#define SYSTEM_LIMIT 64
+#endif
+
+#ifndef GROUP_LIMIT
+#define GROUP_LIMIT 1024
+#endif
+
+// Events kept per thread when tracing, older ones are overwritten.
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS 65536
+#endif
+
+// Maximal number of threads performing blocking handlers.
+#ifndef BLOCKING_POOL_LIMIT
+#define BLOCKING_POOL_LIMIT 64
+#endif
+
+// Idle thread searches for actor IDLE_SPINS times,
+// then yields IDLE_YIELDS times before it parks.
+#ifndef IDLE_SPINS
+#define IDLE_SPINS 1000
+#endif
+
+#ifndef IDLE_YIELDS
+#define IDLE_YIELDS 16
+#endif
+
+// Actor waiting in inbox of its busy home thread is taken by other
+// thread after INBOX_PATIENCE_US microseconds.
+#ifndef INBOX_PATIENCE_US
+#define INBOX_PATIENCE_US 50
+#endif
+
+// High priority messages of one actor, or high priority actors taken
+// by one thread, in a row before normal ones get their turn.
+#ifndef URGENT_BURST
+#define URGENT_BURST 16
+#endif
+
+// Bytes of payload message can carry by value, without allocation.
+#ifndef MESSAGE_INLINE_BYTES
+#define MESSAGE_INLINE_BYTES 64
+#endif
+
 #ifndef POOL_SIZE
 #define POOL_SIZE 3
 #endif
 
+// Maximal number of messages of one actor performed before thread
+// moves on to other actors.
+#ifndef MESSAGE_BATCH
+#define MESSAGE_BATCH 1
+#endif
+
+#define MSG_PRIORITY_NORMAL 0
+#define MSG_PRIORITY_HIGH 1
+
+// Reference counted payload, shared by many messages without copying.
+typedef struct cacti_buf cacti_buf_t;
+
 typedef struct message
 {
     message_type_t message_type;
     size_t nbytes;
-    void *data;
+
+    // If is_inline is set, nbytes of payload are stored in message itself
+    // and copied with it. Handler gets pointer to its copy, valid until
+    // handler returns.
+    union
+    {
+        void *data;
+        _Alignas(max_align_t) unsigned char inline_data[MESSAGE_INLINE_BYTES];
+    };
+    bool is_inline;
+
+    // High priority messages have separate lane in mailbox
+    // and overtake normal ones.
+    int priority;
+
+    // Shared payload, if set handler gets its data and size instead of
+    // data and nbytes. Every accepted message holds its own reference,
+    // released after handler returns or when message is dropped.
+    cacti_buf_t *buf;
 } message_t;
 
+// Copies nbytes of data into message and marks it inline.
+// Returns -1 if they do not fit in MESSAGE_INLINE_BYTES.
+int message_set_inline(message_t *message, const void *data, size_t nbytes);
+
+// Creates buffer of nbytes bytes with one reference, owned by caller.
+cacti_buf_t *cacti_buf_create(size_t nbytes);
+
+void *cacti_buf_data(cacti_buf_t *buf);
+
+size_t cacti_buf_size(cacti_buf_t *buf);
+
+// Returns buffer given data belongs to, so handlers can keep or forward it.
+cacti_buf_t *cacti_buf_of(void *data);
+
+void cacti_buf_retain(cacti_buf_t *buf);
+
+// Drops reference, buffer is freed when last one is dropped.
+void cacti_buf_release(cacti_buf_t *buf);
+
+// Number of references held at the moment, for tests and debugging.
+size_t cacti_buf_references(cacti_buf_t *buf);
+
 typedef long actor_id_t;
 
 actor_id_t actor_id_self();
@@ -38,12 +142,230 @@ typedef struct role
 {
     size_t nprompts;
     act_t *prompts;
+
+    // Messages performed in one dispatch, 0 means system's batch.
+    size_t batch;
+
+    // Handlers of role may block (sleep, do I/O), so its messages are
+    // performed on separate blocking pool and pool threads keep working.
+    // Actor still performs one message at a time.
+    bool blocking;
+
+    // Marks only chosen prompts as blocking, NULL or nprompts flags.
+    const bool *blocking_prompts;
 } role_t;
 
+// Runtime configuration of actor system. Zero fields mean defaults.
+typedef struct cacti_config
+{
+    // Number of threads in pool, defaults to number of online CPUs.
+    size_t threads;
+
+    // Capacity of actor's mailbox, defaults to ACTOR_QUEUE_LIMIT.
+    size_t mailbox_limit;
+
+    // Messages parked for one actor, defaults to PARKED_LIMIT.
+    size_t parked_limit;
+
+    // Maximal number of actors, defaults to CAST_LIMIT.
+    size_t cast_limit;
+
+    // Messages performed in one dispatch, defaults to MESSAGE_BATCH.
+    size_t batch;
+
+    // Searches and yields of idle thread before it parks,
+    // default to IDLE_SPINS and IDLE_YIELDS.
+    size_t idle_spins;
+    size_t idle_yields;
+
+    // Microseconds other threads leave actors in inbox of their home
+    // thread, defaults to INBOX_PATIENCE_US.
+    size_t inbox_patience_us;
+
+    // CPUs pool threads are pinned to, thread i runs on cpus[i % ncpus].
+    // Threads are not pinned if list is empty, unless pin_threads is set,
+    // then they take CPUs process may run on in turn. Each thread
+    // allocates its queues itself, so they stay on its NUMA node,
+    // and actors it spawns start in its queue.
+    const int *cpus;
+    size_t ncpus;
+    bool pin_threads;
+
+    // Maximal number of threads of blocking pool,
+    // defaults to BLOCKING_POOL_LIMIT.
+    size_t blocking_threads;
+
+    // File to which scheduling events are written as Chrome trace JSON
+    // when system ends. Defaults to CACTI_TRACE environment variable,
+    // tracing is off if neither is set.
+    const char *trace_path;
+
+    // Events kept per thread, defaults to TRACE_EVENTS.
+    // Nonzero value turns tracing on even without trace_path.
+    size_t trace_events;
+} cacti_config_t;
+
+// Creates system with compile-time limits, POOL_SIZE threads.
 int actor_system_create(actor_id_t *actor, role_t *const role);
 
+// Creates system with given configuration, NULL means all defaults.
+int actor_system_create_ex(actor_id_t *actor, role_t *const role,
+                           const cacti_config_t *config);
+
 void actor_system_join(actor_id_t actor);
 
+// Actor system independent of the others, with its own threads and limits.
+// Functions above and below work with system of calling thread:
+// handlers with their own one, other threads with default system
+// of actor_system_create unless they chose another by cacti_system_use.
+typedef struct actors_system cacti_system_t;
+
+// Creates new system beside existing ones. Returns NULL if it can not be
+// created, for example when there are already SYSTEM_LIMIT systems.
+cacti_system_t *cacti_system_create(actor_id_t *actor, role_t *const role,
+                                    const cacti_config_t *config);
+
+// Waits until system ends and frees it.
+void cacti_system_join(cacti_system_t *system, actor_id_t actor);
+
+// Makes calling thread work with system, NULL goes back to default one.
+// Has to be called outside of handlers.
+void cacti_system_use(cacti_system_t *system);
+
+// Returns system calling thread works with, NULL if there is none.
+cacti_system_t *cacti_system_current();
+
+// Sends message to actor of given system, also from handlers
+// of other systems.
+int cacti_send_message(cacti_system_t *system, actor_id_t actor,
+                       message_t message);
+
 int send_message(actor_id_t actor, message_t message);
 
+// Creates n actors of role at once, without MSG_SPAWN round-trips.
+// Actor i gets MSG_HELLO with init_data[i] as data, or with id of calling
+// actor (-1 outside of handlers) if init_data is NULL. Ids are stored
+// in ids, unless it is NULL. Returns number of created actors, fewer
+// than n if CAST_LIMIT is reached, or -1 if there is no system.
+long spawn_actors(role_t *const role, size_t n, void *const init_data[],
+                  actor_id_t ids[]);
+
+// Sends count messages to certain actor at once.
+// Returns number of accepted messages, fewer than count if mailbox
+// filled up, or -1 / -2 like send_message.
+long send_messages(actor_id_t actor, const message_t *messages, size_t count);
+
+typedef long group_id_t;
+
+// Creates group with given name, or returns group which already has it.
+// Returns -1 if there are already GROUP_LIMIT groups.
+group_id_t group_create(const char *name);
+
+// Adds actor to group. Actor which joins twice gets messages twice.
+// Returns -1 if actor is dead and -2 if there is no such actor or group.
+int group_join(group_id_t group, actor_id_t actor);
+
+// Removes actor from group. Returns -1 if actor was not its member
+// and -2 if there is no such group.
+int group_leave(group_id_t group, actor_id_t actor);
+
+// Sends message to every member of group, members with full mailboxes
+// are skipped and counted in send_failures. Returns number of members
+// which got the message or -2 if there is no such group.
+long send_group(group_id_t group, message_t message);
+
+// Like send_message, but waits for space instead of returning -1
+// on full mailbox. Called from handler it never waits: message is parked
+// and delivered in order as soon as receiver's mailbox has space.
+// Mailbox counts as full while it has parked messages, so later messages
+// can not overtake them. Returns -1 if parked_limit messages are
+// already parked for the receiver.
+int send_message_blocking(actor_id_t actor, message_t message);
+
+// Like send_message, but waits at most timeout_us microseconds for space
+// in full mailbox. Called from handler it parks message
+// like send_message_blocking instead of waiting.
+int send_message_timed(actor_id_t actor, message_t message, long timeout_us);
+
+// Actor of high priority is run before actors of normal priority,
+// from the next time it becomes runnable.
+// Returns -1 if actor is dead and -2 if there is no such actor.
+int actor_set_priority(actor_id_t actor, int priority);
+
+// Sends message after delay_us microseconds, with millisecond precision.
+// No thread is occupied while waiting. Returns -1 if actor is dead and -2
+// if there is no such actor; message is dropped if actor dies in between.
+// Message without delay is sent at once, parked if mailbox is full;
+// -1 is returned also when parked_limit is reached.
+int send_after(actor_id_t actor, message_t message, long delay_us);
+
+// Sends message every period_us microseconds, first time after one period,
+// until actor dies or system ends. Returns like send_after. Tick which
+// finds mailbox full and parked_limit reached is skipped and counted
+// in send_failures.
+int send_every(actor_id_t actor, message_t message, long period_us);
+
+// Sums over all threads how many times actors were dispatched
+// and how many messages these dispatches drained.
+int actor_system_dispatch_stats(size_t *dispatches, size_t *messages);
+
+// Counters of one pool thread.
+typedef struct cacti_worker_stats
+{
+    size_t dispatches;
+    size_t messages;
+
+    // Nanoseconds spent sleeping for actors and waiting for system's mutex.
+    unsigned long long idle_ns;
+    unsigned long long lock_wait_ns;
+
+    // CPU thread is pinned to (-1 if it is not) and its NUMA node.
+    int cpu;
+    int node;
+} cacti_worker_stats_t;
+
+// Counters of one living actor.
+typedef struct cacti_actor_stats
+{
+    actor_id_t id;
+    size_t messages;
+    // Both count normal and urgent lane, high water is sum of lanes' peaks.
+    size_t mailbox_depth;
+    size_t mailbox_high_water;
+
+    // Messages actor's handlers failed to send.
+    size_t send_failures;
+} cacti_actor_stats_t;
+
+typedef struct cacti_stats
+{
+    size_t living_actors;
+    size_t messages_in_system;
+
+    // Actors waiting for thread in run queues, deques, inboxes of home
+    // threads and queue of blocking pool.
+    size_t run_queue;
+
+    // Messages rejected with -1 or -2, by actors and other threads.
+    size_t send_failures;
+
+    size_t nworkers;
+    cacti_worker_stats_t *workers;
+
+    size_t nactors;
+    cacti_actor_stats_t *actors;
+} cacti_stats_t;
+
+// Takes snapshot of runtime counters. Counters are relaxed, so snapshot
+// is not consistent across them. Arrays are allocated and have to be
+// released with cacti_stats_free. Returns -1 if there is no system.
+int cacti_stats_snapshot(cacti_stats_t *stats);
+
+void cacti_stats_free(cacti_stats_t *stats);
+
+// Writes events recorded so far as Chrome trace JSON, which can be opened
+// in chrome://tracing or Perfetto. Events recorded while writing may be
+// torn. Returns -1 if tracing is off or file can not be written.
+int cacti_trace_dump(const char *path);
+
 #endif
\ No newline at end of file
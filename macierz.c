@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <unistd.h>
+#include <time.h>
 #include "cacti.h"
 
 // Overloading MSG_SUM for admin and normal actor.
@@ -9,10 +9,16 @@
 
 // Admin actor's messages.
 #define MSG_INIT (message_type_t)0x2
-#define MSG_WAIT (message_type_t)0x3
 
 // Calculating actors' messages.
-#define MSG_DATA (message_type_t)0x2
+#define MSG_DONE (message_type_t)0x2
+
+// Every column gets at least this many blocks of rows, so filling
+// and draining the pipeline takes a small part of the whole time.
+#define BLOCKS_PER_COLUMN 16
+
+// Upper limit of rows in one block.
+#define MAX_BLOCK_SIZE 256
 
 
 // Role of admin actor managing calculating actors.
@@ -21,14 +27,18 @@ static role_t admin_role;
 // Role of actor calculating values in matrix.
 static role_t actor_role;
 
-// Structure for storing calculation information.
+// Block of consecutive rows, travels in one cacti_buf_t
+// from column to column.
 typedef struct {
-    // Calculated sum.
-    long sum;
+    // Number of first row in block.
+    int first_row;
 
-    // Row number of calculated sum.
-    int row_number;
-} calculating_t;
+    // Number of rows in block.
+    int rows;
+
+    // Calculated sums of rows.
+    long sums[];
+} block_t;
 
 // Each calculating actor gets column and times to calculate values.
 typedef struct {
@@ -46,22 +56,22 @@ typedef struct {
 
     // Corresponding waiting times.
     int *column_times;
+
+    // Time in microseconds when last scheduled calculation ends.
+    long busy_until;
 } actor_state_t;
 
 // State of admin actor.
 typedef struct {
-    // Stores id of most recent actor who sent MSG_WAIT to admin.
-    actor_id_t previous_id;
-
-    // Which column current actor will get.
-    int current_column;
-
     // Number of columns.
     int column_number;
 
     // Number of rows.
     int row_number;
 
+    // Number of rows sent in one message.
+    int block_size;
+
     // All columns.
     int **columns;
 
@@ -77,20 +87,10 @@ typedef struct {
 
 
 // Hello message handler.
-// Messages admin to get column.
+// Saves state of column sent by admin.
 static void message_hello(void **stateptr, size_t nbytes, void *data) {
-    (void) stateptr;
     (void) nbytes;
-    actor_id_t admin_id = (actor_id_t) data;
-
-    message_t message = {
-            .message_type = MSG_WAIT,
-            .nbytes = sizeof(actor_id_t),
-            .data = (void *) actor_id_self()
-    };
-
-    int error_code = send_message(admin_id, message);
-    assert(error_code == 0);
+    *stateptr = data;
 }
 
 // Empty message hello handler.
@@ -101,105 +101,136 @@ static void message_hello_admin(void **stateptr, size_t nbytes, void *data) {
 }
 
 // Creating admin node.
+// Spawns actors of all columns at once, each gets its state in hello.
+// Then sends blocks of rows to first column, sums are passed from column
+// to column and the last one gives them back to admin.
 static void message_init(void **stateptr, size_t nbytes, void *data) {
     (void) nbytes;
 
     initial_message_t *initial_data = (initial_message_t *) data;
     *stateptr = (void *) initial_data;
 
-    // Create all necessary actors.
-    for (int column = 0; column < initial_data->column_number; ++column) {
-        message_t message = {
-                .message_type = MSG_SPAWN,
-                .nbytes = sizeof(role_t *),
-                .data = (void *) &actor_role
+    int column_number = initial_data->column_number;
+    actor_state_t **states = (actor_state_t **) malloc(
+            column_number * sizeof(actor_state_t *));
+    actor_id_t *ids = (actor_id_t *) malloc(column_number * sizeof(actor_id_t));
+
+    for (int column = 0; column < column_number; ++column) {
+        states[column] = (actor_state_t *) malloc(sizeof(actor_state_t));
+        *states[column] = (actor_state_t) {
+                .already_calculated = 0,
+                .row_number = initial_data->row_number,
+                .column_values = initial_data->columns[column],
+                .column_times = initial_data->times[column],
+                .busy_until = 0
         };
-
-        int error_code = send_message(actor_id_self(), message);
-        assert(error_code == 0);
     }
-}
 
-// Admin actor creates next calculating actor state.
-// If all actors are initialized calls first actor to start calculating.
-static void message_wait(void **stateptr, size_t nbytes, void *data) {
-    (void) nbytes;
-    actor_id_t actor_id = (actor_id_t) data;
+    long spawned = spawn_actors(&actor_role, column_number,
+                                (void *const *) states, ids);
+    assert(spawned == column_number);
+    (void) spawned;
 
-    initial_message_t *initial_data = (initial_message_t *) *stateptr;
+    // Next ids are read only after blocks arrive, which are sent below.
+    for (int column = 0; column < column_number; ++column) {
+        states[column]->next_id = column + 1 < column_number
+                                  ? ids[column + 1] : actor_id_self();
+    }
 
-    actor_state_t *next_state = (actor_state_t *) malloc(sizeof(actor_state_t));
-    *next_state = (actor_state_t) {
-            .next_id = initial_data->previous_id,
-            .already_calculated = 0,
-            .row_number = initial_data->row_number,
-            .column_values = initial_data->columns[initial_data->current_column],
-            .column_times = initial_data->times[initial_data->current_column]
-    };
+    int row_number = initial_data->row_number;
+    int block_size = initial_data->block_size;
+    int block_number = (row_number + block_size - 1) / block_size;
+    message_t *messages = (message_t *) malloc(
+            block_number * sizeof(message_t));
 
-    message_t message = {
-            .message_type = MSG_DATA,
-            .nbytes = sizeof(actor_state_t *),
-            .data = next_state
-    };
+    for (int block = 0; block < block_number; ++block) {
+        int first_row = block * block_size;
+        int rows = row_number - first_row < block_size
+                   ? row_number - first_row : block_size;
 
-    int error_code = send_message(actor_id, message);
-    assert(error_code == 0);
+        cacti_buf_t *buf = cacti_buf_create(
+                sizeof(block_t) + rows * sizeof(long));
+        assert(buf != NULL);
+
+        block_t *current_block = (block_t *) cacti_buf_data(buf);
+        current_block->first_row = first_row;
+        current_block->rows = rows;
 
-    initial_data->current_column--;
-    initial_data->previous_id = actor_id;
-
-    // If each column has corresponding actor, start calculating.
-    if (initial_data->current_column == -1) {
-        for (int row = 0; row < initial_data->row_number; ++row) {
-            calculating_t *current_calculation =
-                    (calculating_t *) malloc(sizeof(calculating_t));
-
-            // 0 is neutral start value.
-            *current_calculation = (calculating_t) {
-                    .row_number = row,
-                    .sum = 0,
-            };
-
-            message = (message_t) {
-                    .message_type = MSG_SUM,
-                    .nbytes = sizeof(calculating_t *),
-                    .data = current_calculation
-            };
-
-            error_code = send_message(actor_id, message);
-            assert(error_code == 0);
+        // 0 is neutral start value.
+        for (int row = 0; row < rows; ++row) {
+            current_block->sums[row] = 0;
         }
+
+        messages[block] = (message_t) {.message_type = MSG_SUM, .buf = buf};
+    }
+
+    long sent = send_messages(ids[0], messages, block_number);
+    assert(sent >= 0);
+
+    // Blocks can outnumber mailbox capacity.
+    for (int block = (int) sent; block < block_number; ++block) {
+        int error_code = send_message_blocking(ids[0], messages[block]);
+        assert(error_code == 0);
+        (void) error_code;
+    }
+
+    // Messages hold their own references.
+    for (int block = 0; block < block_number; ++block) {
+        cacti_buf_release(messages[block].buf);
     }
+
+    free(messages);
+    free(ids);
+    free(states);
 }
 
-// Saves sent data as actor's state.
-static void message_data(void **stateptr, size_t nbytes, void *data) {
-    (void) nbytes;
-    *stateptr = data;
+static long now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000 + now.tv_nsec / 1000;
 }
 
 // Signals actor to start calculating
-// Passed data is calculating_t
+// Passed data is block_t
 static void message_sum(void **stateptr, size_t nbytes, void *data) {
     (void) nbytes;
     actor_state_t *current_state = (actor_state_t *) *stateptr;
-    calculating_t *current_calculation = (calculating_t *) data;
+    block_t *current_block = (block_t *) data;
 
-    // Sleep for given time.
-    usleep(current_state->column_times[current_calculation->row_number]);
+    // Calculations of one actor take given time one after another.
+    // Actor waits on timer instead of sleeping, so its thread is free.
+    long now = now_us();
+    if (current_state->busy_until < now) {
+        current_state->busy_until = now;
+    }
+    for (int row = 0; row < current_block->rows; ++row) {
+        current_state->busy_until +=
+                current_state->column_times[current_block->first_row + row];
+    }
 
-    current_state->already_calculated++;
-    current_calculation->sum +=
-            (long) current_state->column_values[current_calculation->row_number];
+    // Block is passed on without copying.
+    message_t message = {.message_type = MSG_DONE, .buf = cacti_buf_of(data)};
+    int error_code = send_after(actor_id_self(), message,
+                                current_state->busy_until - now);
+    assert(error_code == 0);
+    (void) error_code;
+}
 
-    message_t message = {
-            .message_type = MSG_SUM,
-            .nbytes = sizeof(calculating_t *),
-            .data = current_calculation
-    };
+// Calculation has taken its time, values are added and passed on.
+// Passed data is block_t
+static void message_done(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    actor_state_t *current_state = (actor_state_t *) *stateptr;
+    block_t *current_block = (block_t *) data;
 
-    int error_code = send_message(current_state->next_id, message);
+    current_state->already_calculated += current_block->rows;
+    for (int row = 0; row < current_block->rows; ++row) {
+        current_block->sums[row] += (long) current_state->column_values[
+                current_block->first_row + row];
+    }
+
+    message_t message = {.message_type = MSG_SUM, .buf = cacti_buf_of(data)};
+    int error_code = send_message_blocking(current_state->next_id, message);
     assert(error_code == 0);
 
     // There will be no more calculations.
@@ -220,13 +251,13 @@ static void message_sum(void **stateptr, size_t nbytes, void *data) {
 static void message_sum_admin(void **stateptr, size_t nbytes, void *data) {
     (void) nbytes;
     initial_message_t *admin_data = (initial_message_t *) *stateptr;
-    calculating_t *current_calculation = (calculating_t *) data;
-
-    admin_data->already_calculated++;
-    admin_data->calculated_sums[current_calculation->row_number] =
-            current_calculation->sum;
+    block_t *current_block = (block_t *) data;
 
-    free(current_calculation);
+    admin_data->already_calculated += current_block->rows;
+    for (int row = 0; row < current_block->rows; ++row) {
+        admin_data->calculated_sums[current_block->first_row + row] =
+                current_block->sums[row];
+    }
 
     // All sums are calculated.
     if (admin_data->already_calculated == admin_data->row_number) {
@@ -245,11 +276,27 @@ static void message_sum_admin(void **stateptr, size_t nbytes, void *data) {
     }
 }
 
-int main() {
+// Rows per message: large enough to cut number of messages for many rows,
+// small enough to keep all columns busy at once.
+static int block_size(int k, int n) {
+    int size = k / (BLOCKS_PER_COLUMN * n);
+    if (size < 1) {
+        return 1;
+    }
+    return size < MAX_BLOCK_SIZE ? size : MAX_BLOCK_SIZE;
+}
+
+// Optional argument sets rows per message, 1 sends every row on its own.
+int main(int argc, char *argv[]) {
     int k, n; // rows, columns
     scanf("%d", &k);
     scanf("%d", &n);
 
+    int rows_per_block = argc > 1 ? atoi(argv[1]) : 0;
+    if (rows_per_block < 1) {
+        rows_per_block = block_size(k, n);
+    }
+
     // Values and times per column.
     int **values = (int **) malloc(n * sizeof(int *));
     int **times = (int **) malloc(n * sizeof(int *));
@@ -274,15 +321,14 @@ int main() {
     actor_role.prompts = (act_t[]) {
             message_hello,
             message_sum,
-            message_data
+            message_done
     };
 
-    admin_role.nprompts = 4;
+    admin_role.nprompts = 3;
     admin_role.prompts = (act_t[]) {
             message_hello_admin,
             message_sum_admin,
-            message_init,
-            message_wait
+            message_init
     };
 
     error_code = actor_system_create(&actor_id, &admin_role);
@@ -291,10 +337,9 @@ int main() {
     initial_message_t *initial_message =
             (initial_message_t *) malloc(sizeof(initial_message_t));
     *initial_message = (initial_message_t) {
-            .previous_id = actor_id,
-            .current_column = n - 1,
             .column_number = n,
             .row_number = k,
+            .block_size = rows_per_block,
             .columns = values,
             .times = times,
             .already_calculated = 0,
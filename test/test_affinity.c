@@ -0,0 +1,86 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#define MSG_COUNT (message_type_t)0x1
+
+int tests_run = 0;
+
+static const message_t godie = {
+        .message_type = MSG_GODIE,
+        .nbytes = 0,
+        .data = NULL
+};
+
+static atomic_long counted;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void count(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    counted += (long) data;
+}
+
+static role_t role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {hello, count}
+};
+
+// Both threads share the first CPU, messages still get through.
+static char *pinned_threads()
+{
+    actor_id_t actor;
+    counted = 0;
+    const int cpus[] = {0};
+    cacti_config_t config = {
+            .threads = 2,
+            .cpus = cpus,
+            .ncpus = 1
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    cacti_stats_t snapshot;
+    mu_assert("snapshot", cacti_stats_snapshot(&snapshot) == 0);
+    for (size_t i = 0; i < snapshot.nworkers; ++i) {
+        mu_assert("pinned", snapshot.workers[i].cpu == 0);
+        mu_assert("node", snapshot.workers[i].node >= 0);
+    }
+    cacti_stats_free(&snapshot);
+
+    message_t message = {.message_type = MSG_COUNT, .data = (void *) 7};
+    mu_assert("send", send_message(actor, message) == 0);
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    mu_assert("delivered", counted == 7);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(pinned_threads);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,169 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define MSG_SLEEP (message_type_t)0x1
+#define MSG_COUNT (message_type_t)0x2
+#define MSG_SPAWN_BLOCKING (message_type_t)0x3
+
+#define COUNTS 1000
+#define SLEEPS 50
+
+int tests_run = 0;
+
+static atomic_bool sleeping;
+static atomic_bool counted_while_sleeping;
+static atomic_long counted;
+static atomic_bool inside;
+static atomic_bool overlapped;
+static atomic_long slept;
+static pthread_t hello_thread;
+static pthread_t sleep_thread;
+static atomic_long last_hello;
+
+static role_t blocking_role;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    hello_thread = pthread_self();
+    last_hello = actor_id_self();
+}
+
+// Holds its thread for a while, never two at once for one actor.
+static void sleep_handler(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    if (atomic_exchange(&inside, true)) {
+        overlapped = true;
+    }
+
+    sleep_thread = pthread_self();
+    sleeping = true;
+    usleep((useconds_t) (long) data);
+    sleeping = false;
+    slept++;
+
+    inside = false;
+}
+
+static void count(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    if (++counted == COUNTS && sleeping) {
+        counted_while_sleeping = true;
+    }
+}
+
+static void spawn_blocking(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    send_message(actor_id_self(), (message_t) {
+            .message_type = MSG_SPAWN,
+            .data = &blocking_role
+    });
+}
+
+static role_t blocking_role = {
+        .nprompts = 3,
+        .prompts = (act_t[]) {hello, sleep_handler, count},
+        .blocking = true
+};
+
+static role_t prompt_role = {
+        .nprompts = 4,
+        .prompts = (act_t[]) {hello, sleep_handler, count, spawn_blocking},
+        .blocking_prompts = (bool[]) {false, true, false, false}
+};
+
+// Only pool thread keeps counting while other actor sleeps.
+static char *compute_keeps_working()
+{
+    actor_id_t actor;
+    counted = 0;
+    sleeping = false;
+    counted_while_sleeping = false;
+    cacti_config_t config = {.threads = 1};
+    mu_assert("create", actor_system_create_ex(&actor, &prompt_role, &config) == 0);
+
+    last_hello = actor;
+    message_t message = {.message_type = MSG_SPAWN_BLOCKING};
+    mu_assert("spawn", send_message(actor, message) == 0);
+    while (last_hello == actor) {
+    }
+    actor_id_t sleeper = last_hello;
+
+    message = (message_t) {.message_type = MSG_SLEEP, .data = (void *) 200000};
+    mu_assert("sleep", send_message(sleeper, message) == 0);
+    while (!sleeping) {
+    }
+
+    message = (message_t) {.message_type = MSG_COUNT};
+    for (int i = 0; i < COUNTS; ++i) {
+        mu_assert("count", send_message_blocking(actor, message) == 0);
+    }
+
+    message = (message_t) {.message_type = MSG_GODIE};
+    mu_assert("godie", send_message(actor, message) == 0);
+    mu_assert("godie sleeper", send_message(sleeper, message) == 0);
+    actor_system_join(actor);
+
+    mu_assert("all counted", counted == COUNTS);
+    mu_assert("counted while sleeping", counted_while_sleeping);
+    return 0;
+}
+
+// Blocking prompt runs on other thread, one message of actor at a time.
+static char *blocking_prompt()
+{
+    actor_id_t actor;
+    slept = 0;
+    overlapped = false;
+    cacti_config_t config = {.threads = 2};
+    mu_assert("create", actor_system_create_ex(&actor, &prompt_role, &config) == 0);
+
+    message_t message = {.message_type = MSG_SLEEP, .data = (void *) 1000};
+    for (int i = 0; i < SLEEPS; ++i) {
+        mu_assert("sleep", send_message(actor, message) == 0);
+    }
+
+    message = (message_t) {.message_type = MSG_GODIE};
+    mu_assert("godie", send_message(actor, message) == 0);
+    actor_system_join(actor);
+
+    mu_assert("all slept", slept == SLEEPS);
+    mu_assert("one at a time", !overlapped);
+    mu_assert("other thread", !pthread_equal(hello_thread, sleep_thread));
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(compute_keeps_working);
+    mu_run_test(blocking_prompt);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
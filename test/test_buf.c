@@ -0,0 +1,203 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MSG_READ (message_type_t)0x1
+#define MSG_BOUNCE (message_type_t)0x2
+#define MSG_HOLD (message_type_t)0x3
+#define MSG_IGNORE (message_type_t)0x4
+
+#define RECEIVERS 8
+#define BUF_SIZE (1 << 20)
+#define BOUNCES 100
+
+int tests_run = 0;
+
+static const message_t godie = {
+        .message_type = MSG_GODIE,
+        .nbytes = 0,
+        .data = NULL
+};
+
+static void *shared_data;
+static atomic_long read_ok;
+static atomic_long bounced;
+static atomic_bool held;
+static atomic_bool released;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+// Every receiver sees the very same bytes.
+static void read_buf(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    unsigned char *bytes = data;
+    if (data == shared_data && nbytes == BUF_SIZE
+        && bytes[0] == 0x5a && bytes[BUF_SIZE - 1] == 0x5a) {
+        read_ok++;
+    }
+    send_message(actor_id_self(), godie);
+}
+
+// Sends buffer it got to itself until it has bounced enough times.
+static void bounce(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    if (++bounced < BOUNCES) {
+        message_t message = {.message_type = MSG_BOUNCE, .buf = cacti_buf_of(data)};
+        send_message(actor_id_self(), message);
+    }
+    else {
+        send_message(actor_id_self(), godie);
+    }
+}
+
+// Keeps actor busy until main thread fills its mailbox.
+static void hold(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    held = true;
+    while (!released) {
+    }
+}
+
+static void ignore(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static role_t role = {
+        .nprompts = 5,
+        .prompts = (act_t[]) {hello, read_buf, bounce, hold, ignore}
+};
+
+static char *fan_out()
+{
+    actor_id_t actor;
+    read_ok = 0;
+    mu_assert("create", actor_system_create(&actor, &role) == 0);
+
+    actor_id_t spawned[RECEIVERS];
+    mu_assert("spawn", spawn_actors(&role, RECEIVERS, NULL, spawned)
+                       == RECEIVERS);
+
+    cacti_buf_t *buf = cacti_buf_create(BUF_SIZE);
+    mu_assert("buf", buf != NULL);
+    mu_assert("size", cacti_buf_size(buf) == BUF_SIZE);
+    shared_data = cacti_buf_data(buf);
+    memset(shared_data, 0x5a, BUF_SIZE);
+    mu_assert("of", cacti_buf_of(shared_data) == buf);
+
+    message_t message = {.message_type = MSG_READ, .buf = buf};
+    for (int i = 0; i < RECEIVERS; ++i) {
+        mu_assert("send", send_message(spawned[i], message) == 0);
+    }
+    mu_assert("no such actor",
+              send_message(actor + RECEIVERS + 1, message) == -2);
+
+    // Receivers hold their own references.
+    cacti_buf_release(buf);
+
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    mu_assert("all read", read_ok == RECEIVERS);
+    return 0;
+}
+
+static char *forwarded()
+{
+    actor_id_t actor;
+    bounced = 0;
+    mu_assert("create", actor_system_create(&actor, &role) == 0);
+
+    cacti_buf_t *buf = cacti_buf_create(64);
+    message_t message = {.message_type = MSG_BOUNCE, .buf = buf};
+    mu_assert("send", send_message(actor, message) == 0);
+    cacti_buf_release(buf);
+
+    actor_system_join(actor);
+    mu_assert("bounced", bounced == BOUNCES);
+    return 0;
+}
+
+// Buffers in messages left in mailbox and parked list of actor which
+// is told to die are released with them.
+static char *left_behind()
+{
+    actor_id_t actor;
+    held = false;
+    released = false;
+    cacti_config_t config = {
+            .threads = 2,
+            .mailbox_limit = 4
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    actor_id_t receiver;
+    mu_assert("spawn", spawn_actors(&role, 1, NULL, &receiver) == 1);
+
+    message_t message = {.message_type = MSG_HOLD};
+    mu_assert("hold", send_message(receiver, message) == 0);
+    while (!held) {
+    }
+
+    cacti_buf_t *buf = cacti_buf_create(64);
+    mu_assert("godie", send_message(receiver, godie) == 0);
+    message = (message_t) {.message_type = MSG_IGNORE, .buf = buf};
+    for (int i = 0; i < 3; ++i) {
+        mu_assert("queued", send_message(receiver, message) == 0);
+    }
+    for (int i = 0; i < 2; ++i) {
+        mu_assert("parked", send_after(receiver, message, 0) == 0);
+    }
+    mu_assert("held by messages", cacti_buf_references(buf) == 6);
+    released = true;
+
+    message = (message_t) {.message_type = MSG_IGNORE};
+    while (send_message(receiver, message) == 0) {
+    }
+    mu_assert("dead", send_message(receiver, message) == -1);
+
+    // Only reference of this thread is left.
+    while (cacti_buf_references(buf) > 1) {
+    }
+    cacti_buf_release(buf);
+
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(fan_out);
+    mu_run_test(forwarded);
+    mu_run_test(left_behind);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
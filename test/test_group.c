@@ -0,0 +1,187 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MSG_COUNT (message_type_t)0x1
+#define MSG_NOOP (message_type_t)0x2
+#define MSG_HOLD (message_type_t)0x3
+
+#define MEMBERS 100
+
+int tests_run = 0;
+
+static group_id_t workers;
+static atomic_long joined;
+static atomic_long counted;
+static atomic_long last_member;
+static atomic_bool held;
+static atomic_bool released;
+
+static void root_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void member_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    group_join(workers, actor_id_self());
+    last_member = actor_id_self();
+    joined++;
+}
+
+static void count(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    counted++;
+}
+
+static void noop(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+// Keeps member busy until main thread fills its mailbox.
+static void hold(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    held = true;
+    while (!released) {
+    }
+}
+
+static role_t member_role = {
+        .nprompts = 4,
+        .prompts = (act_t[]) {member_hello, count, noop, hold}
+};
+
+static role_t root_role = {
+        .nprompts = 1,
+        .prompts = (act_t[]) {root_hello}
+};
+
+static char *broadcast()
+{
+    actor_id_t root;
+    joined = 0;
+    counted = 0;
+    mu_assert("create", actor_system_create(&root, &root_role) == 0);
+
+    workers = group_create("workers");
+    mu_assert("group", workers >= 0);
+    mu_assert("same name", group_create("workers") == workers);
+    mu_assert("other name", group_create("others") != workers);
+
+    message_t spawn = {.message_type = MSG_SPAWN, .data = &member_role};
+    for (int i = 0; i < MEMBERS; ++i) {
+        mu_assert("spawn", send_message(root, spawn) == 0);
+    }
+    while (joined < MEMBERS) {
+    }
+
+    message_t message = {.message_type = MSG_COUNT};
+    mu_assert("all members", send_group(workers, message) == MEMBERS);
+
+    mu_assert("leave", group_leave(workers, last_member) == 0);
+    mu_assert("not member", group_leave(workers, last_member) == -1);
+    mu_assert("left member skipped",
+              send_group(workers, message) == MEMBERS - 1);
+
+    message_t godie = {.message_type = MSG_GODIE};
+    mu_assert("godie", send_group(workers, godie) == MEMBERS - 1);
+    mu_assert("godie left member", send_message(last_member, godie) == 0);
+
+    // Members die while performing godie, then are dropped from group.
+    message_t ping = {.message_type = MSG_NOOP};
+    while (send_group(workers, ping) != 0) {
+    }
+    mu_assert("dead members", send_group(workers, message) == 0);
+    mu_assert("no such group", send_group(GROUP_LIMIT, message) == -2);
+
+    mu_assert("godie root", send_message(root, godie) == 0);
+    actor_system_join(root);
+
+    mu_assert("all counted", counted == 2 * MEMBERS - 1);
+    return 0;
+}
+
+// Member with full mailbox is skipped, kept in group and counted as failure.
+static char *full_member()
+{
+    actor_id_t root;
+    joined = 0;
+    counted = 0;
+    held = false;
+    released = false;
+    cacti_config_t config = {
+            .threads = 2,
+            .mailbox_limit = 4
+    };
+    mu_assert("create",
+              actor_system_create_ex(&root, &root_role, &config) == 0);
+
+    workers = group_create("busy");
+    mu_assert("group", workers >= 0);
+
+    message_t spawn = {.message_type = MSG_SPAWN, .data = &member_role};
+    mu_assert("spawn", send_message(root, spawn) == 0);
+    while (joined < 1) {
+    }
+
+    message_t message = {.message_type = MSG_HOLD};
+    mu_assert("hold", send_message(last_member, message) == 0);
+    while (!held) {
+    }
+
+    message = (message_t) {.message_type = MSG_COUNT};
+    for (int i = 0; i < 4; ++i) {
+        mu_assert("fits", send_group(workers, message) == 1);
+    }
+    mu_assert("full member skipped", send_group(workers, message) == 0);
+
+    cacti_stats_t snapshot;
+    mu_assert("snapshot", cacti_stats_snapshot(&snapshot) == 0);
+    mu_assert("failure counted", snapshot.send_failures == 1);
+    cacti_stats_free(&snapshot);
+
+    released = true;
+    while (counted < 4) {
+    }
+
+    message_t godie = {.message_type = MSG_GODIE};
+    mu_assert("still member", send_group(workers, godie) == 1);
+    mu_assert("godie root", send_message(root, godie) == 0);
+    actor_system_join(root);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(broadcast);
+    mu_run_test(full_member);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,166 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#define MSG_BLOCK (message_type_t)0x1
+#define MSG_WHERE (message_type_t)0x2
+
+int tests_run = 0;
+
+static const message_t godie = {
+        .message_type = MSG_GODIE,
+        .nbytes = 0,
+        .data = NULL
+};
+
+static atomic_long counted;
+static atomic_bool blocked;
+static atomic_bool released;
+static atomic_long last_hello;
+static pthread_t home_thread;
+static bool moved;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    last_hello = actor_id_self();
+}
+
+// Holds home thread of actor busy.
+static void block(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    blocked = true;
+    while (!released) {
+    }
+}
+
+// Notes if actor runs on other thread than the first time.
+static void where(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    if (data == NULL) {
+        home_thread = pthread_self();
+    }
+    else if (!pthread_equal(home_thread, pthread_self())) {
+        moved = true;
+    }
+    counted++;
+}
+
+static role_t role = {
+        .nprompts = 3,
+        .prompts = (act_t[]) {hello, block, where}
+};
+
+// Spins until every message sent so far is performed.
+static void wait_for_no_messages() {
+    size_t in_system;
+    do {
+        cacti_stats_t snapshot;
+        cacti_stats_snapshot(&snapshot);
+        in_system = snapshot.messages_in_system;
+        cacti_stats_free(&snapshot);
+    } while (in_system > 0);
+}
+
+// Actor leaves its home thread which is busy performing other actor.
+// Home stays blocked until the message is counted, so only move delivers it.
+static char *busy_home()
+{
+    actor_id_t actor;
+    counted = 0;
+    cacti_config_t config = {
+            .threads = 4,
+            .idle_spins = 1,
+            .idle_yields = 1
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    // Spawned actor starts with home thread of its parent.
+    last_hello = actor;
+    message_t message = {.message_type = MSG_SPAWN, .data = &role};
+    mu_assert("spawn", send_message(actor, message) == 0);
+    while (last_hello == actor) {
+    }
+    actor_id_t spawned = last_hello;
+
+    blocked = false;
+    released = false;
+    message = (message_t) {.message_type = MSG_BLOCK};
+    mu_assert("block", send_message(actor, message) == 0);
+    while (!blocked) {
+    }
+
+    message = (message_t) {.message_type = MSG_WHERE};
+    mu_assert("send", send_message(spawned, message) == 0);
+    while (counted < 1) {
+    }
+    released = true;
+
+    mu_assert("godie", send_message(spawned, godie) == 0);
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+    return 0;
+}
+
+// Actor scheduled from outside stays on its idle home thread, other
+// threads are neither woken for it nor allowed to take it.
+static char *idle_home()
+{
+    actor_id_t actor;
+    counted = 0;
+    moved = false;
+    cacti_config_t config = {
+            .threads = 4,
+            .idle_spins = 1,
+            .idle_yields = 1,
+            .inbox_patience_us = SIZE_MAX
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    // Each message is sent when actor is no longer performed,
+    // so its thread never has it queued for others to steal.
+    for (long i = 0; i < 100; ++i) {
+        wait_for_no_messages();
+        message_t message = {.message_type = MSG_WHERE, .data = (void *) i};
+        mu_assert("send", send_message(actor, message) == 0);
+    }
+
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    mu_assert("every message delivered", counted == 100);
+    mu_assert("stayed on home thread", !moved);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(busy_home);
+    mu_run_test(idle_home);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,82 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define MSG_COUNT (message_type_t)0x1
+
+int tests_run = 0;
+
+static const message_t godie = {
+        .message_type = MSG_GODIE,
+        .nbytes = 0,
+        .data = NULL
+};
+
+static atomic_long counted;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void count(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    counted += (long) data;
+}
+
+static role_t role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {hello, count}
+};
+
+// Workers park right away, every message has to wake one of them.
+static char *parked_workers()
+{
+    actor_id_t actor;
+    counted = 0;
+    cacti_config_t config = {
+            .threads = 4,
+            .idle_spins = 1,
+            .idle_yields = 1
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    for (long i = 1; i <= 20; ++i) {
+        message_t message = {.message_type = MSG_COUNT, .data = (void *) i};
+        mu_assert("send", send_message(actor, message) == 0);
+        usleep(1000);
+    }
+
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    mu_assert("every message delivered", counted == 20 * 21 / 2);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(parked_workers);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
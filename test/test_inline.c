@@ -0,0 +1,89 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#define MSG_INLINE (message_type_t)0x1
+
+int tests_run = 0;
+
+static const message_t godie = {
+        .message_type = MSG_GODIE,
+        .nbytes = 0,
+        .data = NULL
+};
+
+static atomic_long counted;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+// Payload copied into message, data points into it.
+static void inline_sum(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    long *values = data;
+    for (size_t i = 0; i < nbytes / sizeof(long); ++i) {
+        counted += values[i];
+    }
+}
+
+static role_t role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {hello, inline_sum}
+};
+
+static char *inline_payload()
+{
+    actor_id_t actor;
+    counted = 0;
+    mu_assert("create", actor_system_create(&actor, &role) == 0);
+
+    long values[MESSAGE_INLINE_BYTES / sizeof(long)];
+    for (size_t i = 0; i < MESSAGE_INLINE_BYTES / sizeof(long); ++i) {
+        values[i] = (long) i + 1;
+    }
+
+    message_t message = {.message_type = MSG_INLINE};
+    mu_assert("fits", message_set_inline(&message, values, sizeof(values)) == 0);
+    mu_assert("too big",
+              message_set_inline(&message, values, sizeof(values) + 1) == -1);
+
+    // Sender's copy can change once message is sent.
+    mu_assert("send", send_message(actor, message) == 0);
+    values[0] = 1000;
+    mu_assert("send again", message_set_inline(&message, values, sizeof(long)) == 0
+                            && send_message(actor, message) == 0);
+
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    long n = MESSAGE_INLINE_BYTES / sizeof(long);
+    mu_assert("summed", counted == n * (n + 1) / 2 + 1000);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(inline_payload);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
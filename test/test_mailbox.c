@@ -0,0 +1,535 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MSG_COUNT (message_type_t)0x1
+#define MSG_BLOCK (message_type_t)0x2
+#define MSG_CHECK (message_type_t)0x3
+#define MSG_FLOOD (message_type_t)0x4
+#define MSG_ORDERED (message_type_t)0x5
+#define MSG_LIMITED (message_type_t)0x6
+
+#define FLOOD_SIZE 100
+
+#define SENDERS 4
+#define MESSAGES_PER_SENDER 200
+
+int tests_run = 0;
+
+static const message_t godie = {
+        .message_type = MSG_GODIE,
+        .nbytes = 0,
+        .data = NULL
+};
+
+static atomic_long counted;
+static atomic_bool blocked;
+static atomic_bool released;
+static atomic_bool drained_in_batches;
+static long next_expected;
+static bool in_order;
+static atomic_long last_hello;
+static atomic_bool limits_kept;
+static atomic_long parked_sent;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    last_hello = actor_id_self();
+}
+
+static void count(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    counted += (long) data;
+}
+
+// Holds thread until main thread fills the mailbox.
+static void block(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    blocked = true;
+    while (!released) {
+    }
+}
+
+// Checks that dispatches performed more than one message on average.
+static void check(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    size_t dispatches, messages;
+    actor_system_dispatch_stats(&dispatches, &messages);
+    drained_in_batches = messages > 2 * dispatches;
+}
+
+// Sends many messages to actor given in data, more than its mailbox holds.
+static void flood(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    actor_id_t receiver = (actor_id_t) data;
+
+    for (long i = 0; i < FLOOD_SIZE; ++i) {
+        message_t message = {
+                .message_type = MSG_ORDERED,
+                .data = (void *) i
+        };
+        int error_code = send_message_blocking(receiver, message);
+        if (error_code != 0) {
+            in_order = false;
+        }
+    }
+
+    send_message_blocking(receiver, godie);
+    send_message_blocking(actor_id_self(), godie);
+}
+
+static void ordered(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    if ((long) data != next_expected++) {
+        in_order = false;
+    }
+}
+
+// Fills mailbox of receiver given in data and parks messages for it
+// until limit is reached. Nothing overtakes parked messages.
+static void park_limited(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    actor_id_t receiver = (actor_id_t) data;
+    bool kept = true;
+
+    long i = 0;
+    for (; i < 5; ++i) {
+        message_t message = {.message_type = MSG_ORDERED, .data = (void *) i};
+        kept = kept && send_message_blocking(receiver, message) == 0;
+    }
+
+    message_t message = {.message_type = MSG_ORDERED, .data = (void *) i};
+    kept = kept && send_message(receiver, message) == -1;
+    kept = kept && send_messages(receiver, &message, 1) == 0;
+
+    // Only thread would wait for itself.
+    kept = kept && send_message_timed(receiver, message, 10000000) == 0;
+    i++;
+
+    message.data = (void *) i;
+    while (send_message_blocking(receiver, message) == 0) {
+        message.data = (void *) ++i;
+    }
+
+    limits_kept = kept;
+    parked_sent = i;
+    send_message(actor_id_self(), godie);
+}
+
+static role_t role = {
+        .nprompts = 7,
+        .prompts = (act_t[]) {hello, count, block, check, flood, ordered,
+                              park_limited}
+};
+
+static role_t batch_role = {
+        .nprompts = 4,
+        .prompts = (act_t[]) {hello, count, block, check},
+        .batch = 32
+};
+
+static void *sender(void *data) {
+    actor_id_t actor = *(actor_id_t *) data;
+
+    for (long i = 1; i <= MESSAGES_PER_SENDER; ++i) {
+        message_t message = {
+                .message_type = MSG_COUNT,
+                .nbytes = sizeof(long),
+                .data = (void *) i
+        };
+        // Mailbox may be full for a moment.
+        while (send_message(actor, message) == -1) {
+        }
+    }
+
+    return NULL;
+}
+
+static char *many_senders()
+{
+    actor_id_t actor;
+    counted = 0;
+    mu_assert("create", actor_system_create(&actor, &role) == 0);
+
+    pthread_t threads[SENDERS];
+    for (int i = 0; i < SENDERS; ++i) {
+        pthread_create(&threads[i], NULL, sender, &actor);
+    }
+    for (int i = 0; i < SENDERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    long expected = SENDERS * (MESSAGES_PER_SENDER * (MESSAGES_PER_SENDER + 1) / 2);
+    mu_assert("every message delivered once", counted == expected);
+    return 0;
+}
+
+static char *full_mailbox()
+{
+    actor_id_t actor;
+    blocked = false;
+    released = false;
+    mu_assert("create", actor_system_create(&actor, &role) == 0);
+
+    message_t message = {.message_type = MSG_BLOCK};
+    mu_assert("block", send_message(actor, message) == 0);
+    while (!blocked) {
+    }
+
+    message = (message_t) {.message_type = MSG_COUNT};
+    for (int i = 0; i < ACTOR_QUEUE_LIMIT; ++i) {
+        mu_assert("fits", send_message(actor, message) == 0);
+    }
+    mu_assert("full", send_message(actor, message) == -1);
+    mu_assert("no such actor", send_message(actor + 1, message) == -2);
+
+    released = true;
+    while (send_message(actor, godie) == -1) {
+    }
+    actor_system_join(actor);
+    return 0;
+}
+
+static char *configured_limits()
+{
+    actor_id_t actor;
+    blocked = false;
+    released = false;
+    cacti_config_t config = {
+            .threads = 2,
+            .mailbox_limit = 4
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    message_t message = {.message_type = MSG_BLOCK};
+    mu_assert("block", send_message(actor, message) == 0);
+    while (!blocked) {
+    }
+
+    message = (message_t) {.message_type = MSG_COUNT};
+    for (int i = 0; i < 4; ++i) {
+        mu_assert("fits", send_message(actor, message) == 0);
+    }
+    mu_assert("full", send_message(actor, message) == -1);
+
+    released = true;
+    while (send_message(actor, godie) == -1) {
+    }
+    actor_system_join(actor);
+    return 0;
+}
+
+static void *release_later(void *data) {
+    (void) data;
+    usleep(10000);
+    released = true;
+    return NULL;
+}
+
+static char *blocking_send()
+{
+    actor_id_t actor;
+    blocked = false;
+    released = false;
+    counted = 0;
+    cacti_config_t config = {
+            .threads = 2,
+            .mailbox_limit = 4
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    message_t message = {.message_type = MSG_BLOCK};
+    mu_assert("block", send_message(actor, message) == 0);
+    while (!blocked) {
+    }
+
+    message = (message_t) {.message_type = MSG_COUNT, .data = (void *) 1};
+    for (int i = 0; i < 4; ++i) {
+        mu_assert("fits", send_message(actor, message) == 0);
+    }
+    mu_assert("timed out", send_message_timed(actor, message, 1000) == -1);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, release_later, NULL);
+    for (int i = 0; i < 20; ++i) {
+        mu_assert("waited", send_message_blocking(actor, message) == 0);
+    }
+    pthread_join(thread, NULL);
+
+    mu_assert("godie", send_message_blocking(actor, godie) == 0);
+    actor_system_join(actor);
+    mu_assert("all counted", counted == 24);
+    return 0;
+}
+
+static char *batched_send()
+{
+    actor_id_t actor;
+    blocked = false;
+    released = false;
+    counted = 0;
+    cacti_config_t config = {
+            .threads = 2,
+            .mailbox_limit = 8
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    message_t message = {.message_type = MSG_BLOCK};
+    mu_assert("block", send_message(actor, message) == 0);
+    while (!blocked) {
+    }
+
+    message_t messages[6];
+    for (int i = 0; i < 6; ++i) {
+        messages[i] = (message_t) {.message_type = MSG_COUNT, .data = (void *) 1};
+    }
+    mu_assert("all fit", send_messages(actor, messages, 6) == 6);
+    mu_assert("partially", send_messages(actor, messages, 6) == 2);
+    mu_assert("full", send_messages(actor, messages, 6) == 0);
+    mu_assert("no such actor", send_messages(actor + 1, messages, 6) == -2);
+
+    released = true;
+    while (send_message(actor, godie) == -1) {
+    }
+    actor_system_join(actor);
+    mu_assert("accepted counted", counted == 8);
+    return 0;
+}
+
+// Mailbox keeps its own copies of messages, so sender can overwrite
+// its array of messages before any of them is performed.
+static char *by_value()
+{
+    actor_id_t actor;
+    blocked = false;
+    released = false;
+    next_expected = 0;
+    in_order = true;
+    mu_assert("create", actor_system_create(&actor, &role) == 0);
+
+    message_t message = {.message_type = MSG_BLOCK};
+    mu_assert("block", send_message(actor, message) == 0);
+    while (!blocked) {
+    }
+
+    message_t messages[16];
+    for (long i = 0; i < 16; ++i) {
+        messages[i] = (message_t) {.message_type = MSG_ORDERED,
+                                   .data = (void *) i};
+    }
+    for (int i = 0; i < 8; ++i) {
+        mu_assert("send", send_message(actor, messages[i]) == 0);
+    }
+    mu_assert("batch", send_messages(actor, messages + 8, 8) == 8);
+
+    // Reused buffer would be read as a flood of wrong numbers.
+    for (int i = 0; i < 16; ++i) {
+        messages[i] = (message_t) {.message_type = MSG_FLOOD,
+                                   .data = (void *) -1};
+    }
+    released = true;
+
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    mu_assert("in order", in_order);
+    mu_assert("all delivered", next_expected == 16);
+    return 0;
+}
+
+// Mailbox grows while actor is busy and gives its rings back when drained,
+// messages keep their order over many such rounds.
+static char *grow_and_shrink()
+{
+    actor_id_t actor;
+    counted = 0;
+    next_expected = 0;
+    in_order = true;
+    cacti_config_t config = {
+            .threads = 2,
+            .mailbox_limit = 256
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    long sent = 0;
+    long expected = 0;
+    for (int round = 0; round < 10; ++round) {
+        blocked = false;
+        released = false;
+        message_t message = {.message_type = MSG_BLOCK};
+        mu_assert("block", send_message(actor, message) == 0);
+        while (!blocked) {
+        }
+
+        // Rounds alternate between filling both lanes and few messages.
+        long size = round % 2 == 0 ? 255 : 3;
+        for (long i = 0; i < size; ++i) {
+            message = (message_t) {.message_type = MSG_ORDERED,
+                                   .data = (void *) sent++};
+            mu_assert("fits", send_message(actor, message) == 0);
+            message = (message_t) {.message_type = MSG_COUNT,
+                                   .data = (void *) 1,
+                                   .priority = MSG_PRIORITY_HIGH};
+            mu_assert("urgent fits", send_message(actor, message) == 0);
+        }
+        message = (message_t) {.message_type = MSG_COUNT, .data = (void *) 1};
+        mu_assert("last fits", send_message(actor, message) == 0);
+        expected += size + 1;
+        released = true;
+
+        while (counted != expected) {
+        }
+    }
+
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    mu_assert("in order", in_order);
+    mu_assert("all delivered", next_expected == sent);
+    return 0;
+}
+
+// Handler floods small mailbox, messages are parked instead of blocking.
+static char *parked_send()
+{
+    actor_id_t sender;
+    next_expected = 0;
+    in_order = true;
+    cacti_config_t config = {
+            .threads = 1,
+            .mailbox_limit = 4
+    };
+    mu_assert("create", actor_system_create_ex(&sender, &role, &config) == 0);
+
+    last_hello = sender;
+    message_t message = {.message_type = MSG_SPAWN, .data = &role};
+    mu_assert("spawn", send_message(sender, message) == 0);
+
+    while (last_hello == sender) {
+    }
+    actor_id_t receiver = last_hello;
+
+    message = (message_t) {.message_type = MSG_FLOOD, .data = (void *) receiver};
+    mu_assert("flood", send_message(sender, message) == 0);
+    actor_system_join(sender);
+
+    mu_assert("in order", in_order);
+    mu_assert("all delivered", next_expected == FLOOD_SIZE);
+    return 0;
+}
+
+// Handler's blocking and timed sends park at most parked_limit messages.
+static char *parked_limit()
+{
+    actor_id_t sender;
+    next_expected = 0;
+    in_order = true;
+    parked_sent = 0;
+    cacti_config_t config = {
+            .threads = 1,
+            .mailbox_limit = 4,
+            .parked_limit = 8
+    };
+    mu_assert("create", actor_system_create_ex(&sender, &role, &config) == 0);
+
+    last_hello = sender;
+    message_t message = {.message_type = MSG_SPAWN, .data = &role};
+    mu_assert("spawn", send_message(sender, message) == 0);
+
+    while (last_hello == sender) {
+    }
+    actor_id_t receiver = last_hello;
+
+    message = (message_t) {.message_type = MSG_LIMITED, .data = (void *) receiver};
+    mu_assert("limited", send_message(sender, message) == 0);
+    while (parked_sent == 0) {
+    }
+
+    // Waits until parked messages are delivered.
+    mu_assert("godie", send_message_blocking(receiver, godie) == 0);
+    actor_system_join(sender);
+
+    mu_assert("limits kept", limits_kept);
+    mu_assert("mailbox and parked", parked_sent == 4 + 8);
+    mu_assert("in order", in_order);
+    mu_assert("all delivered", next_expected == 4 + 8);
+    return 0;
+}
+
+static char *batch()
+{
+    actor_id_t actor;
+    blocked = false;
+    released = false;
+    drained_in_batches = false;
+    mu_assert("create", actor_system_create(&actor, &batch_role) == 0);
+
+    message_t message = {.message_type = MSG_BLOCK};
+    mu_assert("block", send_message(actor, message) == 0);
+    while (!blocked) {
+    }
+
+    message = (message_t) {.message_type = MSG_COUNT};
+    for (int i = 0; i < 100; ++i) {
+        mu_assert("fits", send_message(actor, message) == 0);
+    }
+    message = (message_t) {.message_type = MSG_CHECK};
+    mu_assert("check", send_message(actor, message) == 0);
+    mu_assert("godie", send_message(actor, godie) == 0);
+
+    released = true;
+    actor_system_join(actor);
+    mu_assert("drained in batches", drained_in_batches);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(many_senders);
+    mu_run_test(full_mailbox);
+    mu_run_test(configured_limits);
+    mu_run_test(blocking_send);
+    mu_run_test(batched_send);
+    mu_run_test(by_value);
+    mu_run_test(grow_and_shrink);
+    mu_run_test(parked_send);
+    mu_run_test(parked_limit);
+    mu_run_test(batch);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,184 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MSG_BLOCK (message_type_t)0x1
+#define MSG_LOG (message_type_t)0x2
+
+#define LOG_SIZE 64
+#define NORMAL_ACTORS 3
+
+int tests_run = 0;
+
+static const message_t godie = {
+        .message_type = MSG_GODIE,
+        .nbytes = 0,
+        .data = NULL
+};
+
+static atomic_bool blocked;
+static atomic_bool released;
+static long logged[LOG_SIZE];
+static atomic_size_t log_size;
+static atomic_size_t greeted;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    greeted++;
+}
+
+// Holds the only thread until main thread has sent everything.
+static void block(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    blocked = true;
+    while (!released) {
+    }
+}
+
+static void log_message(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    logged[log_size++] = (long) data;
+}
+
+static role_t role = {
+        .nprompts = 3,
+        .prompts = (act_t[]) {hello, block, log_message}
+};
+
+static void block_thread(actor_id_t actor) {
+    blocked = false;
+    released = false;
+    send_message(actor, (message_t) {.message_type = MSG_BLOCK});
+    while (!blocked) {
+    }
+}
+
+static char *urgent_overtakes()
+{
+    actor_id_t actor;
+    log_size = 0;
+    cacti_config_t config = {.threads = 1};
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    block_thread(actor);
+    for (long i = 1; i <= 5; ++i) {
+        message_t message = {.message_type = MSG_LOG, .data = (void *) i};
+        mu_assert("normal", send_message(actor, message) == 0);
+    }
+    message_t message = {
+            .message_type = MSG_LOG,
+            .data = (void *) 100,
+            .priority = MSG_PRIORITY_HIGH
+    };
+    mu_assert("high", send_message(actor, message) == 0);
+    released = true;
+
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    mu_assert("all logged", log_size == 6);
+    mu_assert("high first", logged[0] == 100);
+    mu_assert("normal in order", logged[1] == 1 && logged[5] == 5);
+    return 0;
+}
+
+// Normal message gets its turn after URGENT_BURST urgent ones.
+static char *no_starvation()
+{
+    actor_id_t actor;
+    log_size = 0;
+    cacti_config_t config = {.threads = 1};
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    block_thread(actor);
+    message_t message = {.message_type = MSG_LOG, .data = (void *) -1};
+    mu_assert("normal", send_message(actor, message) == 0);
+
+    message.priority = MSG_PRIORITY_HIGH;
+    for (long i = 0; i < 2 * URGENT_BURST; ++i) {
+        message.data = (void *) i;
+        mu_assert("high", send_message(actor, message) == 0);
+    }
+    released = true;
+
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    mu_assert("all logged", log_size == 2 * URGENT_BURST + 1);
+    mu_assert("burst first", logged[0] == 0);
+    mu_assert("normal after burst", logged[URGENT_BURST] == -1);
+    return 0;
+}
+
+// High priority actor is run before normal actors scheduled earlier.
+static char *urgent_actor()
+{
+    actor_id_t actor;
+    log_size = 0;
+    greeted = 0;
+    cacti_config_t config = {.threads = 1};
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    actor_id_t spawned[NORMAL_ACTORS + 1];
+    mu_assert("spawn", spawn_actors(&role, NORMAL_ACTORS + 1, NULL, spawned)
+                       == NORMAL_ACTORS + 1);
+
+    // Priority counts from the next time actor becomes runnable.
+    while (greeted < NORMAL_ACTORS + 2) {
+    }
+    actor_id_t urgent = spawned[NORMAL_ACTORS];
+    mu_assert("priority", actor_set_priority(urgent, MSG_PRIORITY_HIGH) == 0);
+    mu_assert("no such actor", actor_set_priority(urgent + 1, 1) == -2);
+
+    block_thread(actor);
+    for (int i = 0; i <= NORMAL_ACTORS; ++i) {
+        message_t message = {.message_type = MSG_LOG, .data = (void *) spawned[i]};
+        mu_assert("log", send_message(spawned[i], message) == 0);
+    }
+    released = true;
+
+    for (int i = 0; i <= NORMAL_ACTORS; ++i) {
+        mu_assert("godie", send_message(spawned[i], godie) == 0);
+    }
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    mu_assert("all logged", log_size == NORMAL_ACTORS + 1);
+
+    // Every URGENT_BURST-th search skips urgent actors, so one normal
+    // actor may go first.
+    mu_assert("urgent early", logged[0] == urgent || logged[1] == urgent);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(urgent_overtakes);
+    mu_run_test(no_starvation);
+    mu_run_test(urgent_actor);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,245 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MSG_START (message_type_t)0x1
+#define MSG_DONE (message_type_t)0x2
+#define MSG_BULK (message_type_t)0x3
+#define MSG_PING (message_type_t)0x1
+
+#define SPAWNS 1000
+#define BULK 10
+
+// More actors than one chunk of registry holds.
+#define CROWD 1500
+
+int tests_run = 0;
+
+static int spawned;
+static actor_id_t first_child;
+static int stale_send_result;
+static long bulk_spawned;
+static atomic_long bulk_sum;
+static atomic_long greeted;
+static atomic_long pinged;
+
+static role_t child_role;
+
+static role_t bulk_role;
+
+static void parent_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void parent_start(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    send_message(actor_id_self(), (message_t) {
+            .message_type = MSG_SPAWN,
+            .data = &child_role
+    });
+}
+
+// Child has died, spawns next one until enough.
+static void parent_done(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    actor_id_t child = (actor_id_t) data;
+
+    if (spawned == 0) {
+        first_child = child;
+    }
+    spawned++;
+
+    if (spawned < SPAWNS) {
+        parent_start(stateptr, nbytes, data);
+    }
+    else {
+        stale_send_result = send_message(first_child, (message_t) {
+                .message_type = MSG_DONE
+        });
+        send_message(actor_id_self(), (message_t) {
+                .message_type = MSG_GODIE
+        });
+    }
+}
+
+// Spawns more children at once than fit in cast_limit.
+static void parent_bulk(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    void *init_data[BULK];
+    for (long i = 0; i < BULK; ++i) {
+        init_data[i] = (void *) (i + 1);
+    }
+
+    actor_id_t ids[BULK];
+    bulk_spawned = spawn_actors(&bulk_role, BULK, init_data, ids);
+    send_message(actor_id_self(), (message_t) {.message_type = MSG_GODIE});
+}
+
+// Gets its own number in hello.
+static void bulk_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    bulk_sum += (long) data;
+    send_message(actor_id_self(), (message_t) {.message_type = MSG_GODIE});
+}
+
+static void child_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    actor_id_t parent = (actor_id_t) data;
+
+    send_message(actor_id_self(), (message_t) {.message_type = MSG_GODIE});
+    send_message(parent, (message_t) {
+            .message_type = MSG_DONE,
+            .data = (void *) actor_id_self()
+    });
+}
+
+static void crowd_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    greeted++;
+}
+
+static void crowd_ping(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    pinged += (long) data;
+}
+
+static role_t crowd_role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {crowd_hello, crowd_ping}
+};
+
+static role_t parent_role = {
+        .nprompts = 4,
+        .prompts = (act_t[]) {parent_hello, parent_start, parent_done,
+                              parent_bulk}
+};
+
+static role_t bulk_role = {
+        .nprompts = 1,
+        .prompts = (act_t[]) {bulk_hello}
+};
+
+static role_t child_role = {
+        .nprompts = 1,
+        .prompts = (act_t[]) {child_hello}
+};
+
+// Many more actors than cast_limit are spawned over time,
+// which works only if dead ones give their slots back.
+static char *churn()
+{
+    actor_id_t actor;
+    spawned = 0;
+    cacti_config_t config = {
+            .threads = 2,
+            .cast_limit = 8
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &parent_role, &config) == 0);
+    mu_assert("start", send_message(actor, (message_t) {
+            .message_type = MSG_START
+    }) == 0);
+    actor_system_join(actor);
+
+    mu_assert("all spawned", spawned == SPAWNS);
+    mu_assert("stale id rejected", stale_send_result == -1);
+    return 0;
+}
+
+// Children get their own data in hello, as many as there is place for.
+static char *bulk()
+{
+    actor_id_t actor;
+    bulk_sum = 0;
+    cacti_config_t config = {
+            .threads = 2,
+            .cast_limit = 8
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &parent_role, &config) == 0);
+    mu_assert("bulk", send_message(actor, (message_t) {
+            .message_type = MSG_BULK
+    }) == 0);
+    actor_system_join(actor);
+
+    mu_assert("limited", bulk_spawned == 7);
+    mu_assert("own data", bulk_sum == 7 * 8 / 2);
+    return 0;
+}
+
+// Living actors fill more than one chunk of registry, actors in
+// the second chunk get messages and ids past allocated chunks do not exist.
+static char *chunks()
+{
+    actor_id_t actor;
+    greeted = 0;
+    pinged = 0;
+    cacti_config_t config = {
+            .threads = 2,
+            .cast_limit = 4 * 1024
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &crowd_role, &config) == 0);
+
+    static actor_id_t ids[CROWD];
+    mu_assert("spawn", spawn_actors(&crowd_role, CROWD, NULL, ids) == CROWD);
+    while (greeted < CROWD + 1) {
+    }
+
+    for (long i = 1024; i < CROWD; ++i) {
+        message_t message = {.message_type = MSG_PING, .data = (void *) 1};
+        mu_assert("second chunk", send_message(ids[i], message) == 0);
+    }
+    mu_assert("past chunks", send_message(ids[CROWD - 1] + 1024,
+                                          (message_t) {.message_type = MSG_PING})
+                             == -2);
+    mu_assert("past limit", send_message((actor_id_t) 4 * 1024 + 1,
+                                         (message_t) {.message_type = MSG_PING})
+                            == -2);
+    while (pinged < CROWD - 1024) {
+    }
+
+    message_t godie = {.message_type = MSG_GODIE};
+    for (long i = 0; i < CROWD; ++i) {
+        mu_assert("godie", send_message(ids[i], godie) == 0);
+    }
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(churn);
+    mu_run_test(bulk);
+    mu_run_test(chunks);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
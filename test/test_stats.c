@@ -0,0 +1,163 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MSG_COUNT (message_type_t)0x1
+#define MSG_BLOCK (message_type_t)0x2
+
+int tests_run = 0;
+
+static const message_t godie = {
+        .message_type = MSG_GODIE,
+        .nbytes = 0,
+        .data = NULL
+};
+
+static atomic_long counted;
+static atomic_bool blocked;
+static atomic_bool released;
+static atomic_long last_hello;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    last_hello = actor_id_self();
+}
+
+static void count(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    counted += (long) data;
+}
+
+// Holds thread until main thread fills the mailbox.
+static void block(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    blocked = true;
+    while (!released) {
+    }
+}
+
+static role_t role = {
+        .nprompts = 3,
+        .prompts = (act_t[]) {hello, count, block}
+};
+
+static char *stats()
+{
+    actor_id_t actor;
+    blocked = false;
+    released = false;
+    cacti_config_t config = {
+            .threads = 2,
+            .mailbox_limit = 4
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    message_t message = {.message_type = MSG_BLOCK};
+    mu_assert("block", send_message(actor, message) == 0);
+    while (!blocked) {
+    }
+
+    message = (message_t) {.message_type = MSG_COUNT};
+    for (int i = 0; i < 4; ++i) {
+        mu_assert("fits", send_message(actor, message) == 0);
+    }
+    mu_assert("full", send_message(actor, message) == -1);
+    mu_assert("no such actor", send_message(actor + 1, message) == -2);
+
+    message.priority = MSG_PRIORITY_HIGH;
+    for (int i = 0; i < 2; ++i) {
+        mu_assert("urgent fits", send_message(actor, message) == 0);
+    }
+
+    cacti_stats_t snapshot;
+    mu_assert("snapshot", cacti_stats_snapshot(&snapshot) == 0);
+    mu_assert("workers", snapshot.nworkers == 2);
+    mu_assert("one actor", snapshot.nactors == 1);
+    mu_assert("actor id", snapshot.actors[0].id == actor);
+    mu_assert("hello handled", snapshot.actors[0].messages == 1);
+    mu_assert("depth", snapshot.actors[0].mailbox_depth == 6);
+    mu_assert("high water", snapshot.actors[0].mailbox_high_water == 6);
+    mu_assert("failures", snapshot.send_failures == 2);
+    mu_assert("living", snapshot.living_actors == 1);
+    mu_assert("in system", snapshot.messages_in_system == 7);
+    cacti_stats_free(&snapshot);
+
+    released = true;
+    while (send_message(actor, godie) == -1) {
+    }
+    actor_system_join(actor);
+    return 0;
+}
+
+// Actor waiting in inbox of its busy home thread is in run queue.
+static char *queued_in_inbox()
+{
+    actor_id_t actor;
+    counted = 0;
+    cacti_config_t config = {.threads = 1};
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    last_hello = actor;
+    message_t message = {.message_type = MSG_SPAWN, .data = &role};
+    mu_assert("spawn", send_message(actor, message) == 0);
+    while (last_hello == actor) {
+    }
+    actor_id_t spawned = last_hello;
+
+    // The only thread, home of both actors, gets busy. It has released
+    // spawned actor before it takes the parent.
+    blocked = false;
+    released = false;
+    message = (message_t) {.message_type = MSG_BLOCK};
+    mu_assert("block", send_message(actor, message) == 0);
+    while (!blocked) {
+    }
+
+    message = (message_t) {.message_type = MSG_COUNT, .data = (void *) 1};
+    mu_assert("send", send_message(spawned, message) == 0);
+
+    cacti_stats_t snapshot;
+    mu_assert("snapshot", cacti_stats_snapshot(&snapshot) == 0);
+    mu_assert("in inbox", snapshot.run_queue == 1);
+    cacti_stats_free(&snapshot);
+
+    released = true;
+    while (counted < 1) {
+    }
+
+    mu_assert("godie", send_message(spawned, godie) == 0);
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(stats);
+    mu_run_test(queued_in_inbox);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
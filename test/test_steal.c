@@ -0,0 +1,125 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#define MSG_FLOOD (message_type_t)0x1
+#define MSG_WORK (message_type_t)0x1
+
+#define CHILDREN 8
+#define MESSAGES 200
+
+int tests_run = 0;
+
+static const message_t godie = {
+        .message_type = MSG_GODIE,
+        .nbytes = 0,
+        .data = NULL
+};
+
+static pthread_t parent_thread;
+static atomic_long started;
+static atomic_long worked;
+static atomic_long stolen;
+
+static role_t child_role;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+// Spawns children on its own thread and floods them, then keeps
+// the thread busy until every child has run somewhere else.
+static void flood(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    parent_thread = pthread_self();
+
+    actor_id_t children[CHILDREN];
+    spawn_actors(&child_role, CHILDREN, NULL, children);
+
+    for (long i = 0; i < MESSAGES; ++i) {
+        for (int child = 0; child < CHILDREN; ++child) {
+            message_t message = {.message_type = MSG_WORK, .data = (void *) 1};
+            send_message(children[child], message);
+        }
+    }
+
+    while (started < CHILDREN) {
+    }
+
+    for (int child = 0; child < CHILDREN; ++child) {
+        send_message(children[child], godie);
+    }
+    send_message(actor_id_self(), godie);
+}
+
+static void work(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    if (*stateptr == NULL) {
+        *stateptr = stateptr;
+        started++;
+        if (!pthread_equal(parent_thread, pthread_self())) {
+            stolen++;
+        }
+    }
+    worked += (long) data;
+}
+
+static role_t role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {hello, flood}
+};
+
+static role_t child_role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {hello, work}
+};
+
+// Children start in deque of the busy parent's thread, so they can
+// only run if other threads steal them. Owner and thieves then take
+// from the same deque, every message is performed exactly once.
+static char *stealing()
+{
+    actor_id_t actor;
+    started = 0;
+    worked = 0;
+    stolen = 0;
+    cacti_config_t config = {.threads = 4};
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    message_t message = {.message_type = MSG_FLOOD};
+    mu_assert("flood", send_message(actor, message) == 0);
+    actor_system_join(actor);
+
+    mu_assert("every child stolen", stolen == CHILDREN);
+    mu_assert("every message once", worked == CHILDREN * MESSAGES);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(stealing);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,167 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MSG_COUNT (message_type_t)0x1
+#define MSG_FORWARD (message_type_t)0x2
+
+#define SYSTEMS 3
+#define MESSAGES 100
+
+int tests_run = 0;
+
+static const message_t godie = {
+        .message_type = MSG_GODIE,
+        .nbytes = 0,
+        .data = NULL
+};
+
+static atomic_long counted[SYSTEMS];
+static cacti_system_t *systems[SYSTEMS];
+static actor_id_t actors[SYSTEMS];
+static atomic_bool own_system;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+// Counts message in slot of system handler runs in.
+static void count(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    cacti_system_t *current = cacti_system_current();
+    for (int i = 0; i < SYSTEMS; ++i) {
+        if (systems[i] == current) {
+            counted[i] += (long) data;
+        }
+    }
+}
+
+// Forwards message to first actor of every other system, then dies.
+static void forward(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    cacti_system_t *current = cacti_system_current();
+    own_system = current == systems[(long) data];
+
+    for (int i = 0; i < SYSTEMS; ++i) {
+        if (systems[i] != current) {
+            message_t message = {.message_type = MSG_COUNT, .data = (void *) 1};
+            cacti_send_message(systems[i], actors[i], message);
+            cacti_send_message(systems[i], actors[i], godie);
+        }
+    }
+    send_message(actor_id_self(), godie);
+}
+
+static role_t role = {
+        .nprompts = 3,
+        .prompts = (act_t[]) {hello, count, forward}
+};
+
+// Systems with separate threads count their own messages.
+static char *independent()
+{
+    cacti_config_t config = {.threads = 1};
+    for (int i = 0; i < SYSTEMS; ++i) {
+        counted[i] = 0;
+        systems[i] = cacti_system_create(&actors[i], &role, &config);
+        mu_assert("create", systems[i] != NULL);
+    }
+
+    for (long n = 1; n <= MESSAGES; ++n) {
+        for (int i = 0; i < SYSTEMS; ++i) {
+            message_t message = {.message_type = MSG_COUNT, .data = (void *) n};
+            mu_assert("send",
+                      cacti_send_message(systems[i], actors[i], message) == 0);
+        }
+    }
+
+    for (int i = 0; i < SYSTEMS; ++i) {
+        mu_assert("godie", cacti_send_message(systems[i], actors[i], godie) == 0);
+        cacti_system_join(systems[i], actors[i]);
+    }
+
+    for (int i = 0; i < SYSTEMS; ++i) {
+        mu_assert("counted", counted[i] == MESSAGES * (MESSAGES + 1) / 2);
+    }
+    return 0;
+}
+
+// Handler of one system sends to the others.
+static char *across()
+{
+    cacti_config_t config = {.threads = 2};
+    for (int i = 0; i < SYSTEMS; ++i) {
+        counted[i] = 0;
+        systems[i] = cacti_system_create(&actors[i], &role, &config);
+        mu_assert("create", systems[i] != NULL);
+    }
+
+    message_t message = {.message_type = MSG_FORWARD, .data = (void *) 0};
+    mu_assert("forward", cacti_send_message(systems[0], actors[0], message) == 0);
+
+    for (int i = 0; i < SYSTEMS; ++i) {
+        cacti_system_join(systems[i], actors[i]);
+    }
+
+    mu_assert("handler in own system", own_system);
+    mu_assert("first not counted", counted[0] == 0);
+    for (int i = 1; i < SYSTEMS; ++i) {
+        mu_assert("forwarded", counted[i] == 1);
+    }
+    return 0;
+}
+
+// Default system of the old API lives beside independent ones.
+static char *default_shim()
+{
+    actor_id_t actor;
+    mu_assert("create default", actor_system_create(&actor, &role) == 0);
+    mu_assert("only one default", actor_system_create(&actor, &role) == -1);
+
+    cacti_system_t *other = cacti_system_create(&actors[0], &role, NULL);
+    mu_assert("create other", other != NULL);
+    mu_assert("current is default", cacti_system_current() != other);
+
+    cacti_system_use(other);
+    mu_assert("chosen", cacti_system_current() == other);
+    mu_assert("godie other", send_message(actors[0], godie) == 0);
+    cacti_system_join(other, actors[0]);
+    mu_assert("back to default", cacti_system_current() != NULL);
+
+    mu_assert("godie default", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+    mu_assert("no system", cacti_system_current() == NULL);
+    mu_assert("no actor", send_message(actor, godie) == -2);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(independent);
+    mu_run_test(across);
+    mu_run_test(default_shim);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
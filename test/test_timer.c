@@ -0,0 +1,278 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MSG_ARRIVE (message_type_t)0x1
+#define MSG_TICK (message_type_t)0x2
+#define MSG_MANY (message_type_t)0x3
+#define MSG_HOLD (message_type_t)0x4
+#define MSG_BEAT (message_type_t)0x5
+
+#define TICKS 5
+#define TIMERS 5000
+
+int tests_run = 0;
+
+static atomic_long arrived_at;
+static atomic_long immediate_at;
+static atomic_long ticks;
+static atomic_long many;
+static atomic_long beats;
+static atomic_bool held;
+static atomic_bool released;
+
+static long now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+// Message with data 0 is the delayed one.
+static void arrive(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    if (data == NULL) {
+        arrived_at = now_us();
+        send_message(actor_id_self(), (message_t) {.message_type = MSG_GODIE});
+    }
+    else {
+        immediate_at = now_us();
+    }
+}
+
+static void tick(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    if (++ticks == TICKS) {
+        send_message(actor_id_self(), (message_t) {.message_type = MSG_GODIE});
+    }
+}
+
+static void count(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    if (++many == TIMERS) {
+        send_message(actor_id_self(), (message_t) {.message_type = MSG_GODIE});
+    }
+}
+
+// Keeps actor busy until main thread fills its mailbox.
+static void hold(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    held = true;
+    while (!released) {
+    }
+}
+
+static void beat(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    beats++;
+}
+
+static role_t role = {
+        .nprompts = 6,
+        .prompts = (act_t[]) {hello, arrive, tick, count, hold, beat}
+};
+
+static size_t send_failures() {
+    cacti_stats_t snapshot;
+    cacti_stats_snapshot(&snapshot);
+    size_t failures = snapshot.send_failures;
+    cacti_stats_free(&snapshot);
+    return failures;
+}
+
+// Delayed message does not occupy the only thread.
+static char *delayed()
+{
+    actor_id_t actor;
+    arrived_at = 0;
+    immediate_at = 0;
+    cacti_config_t config = {.threads = 1};
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    long sent_at = now_us();
+    message_t message = {.message_type = MSG_ARRIVE};
+    mu_assert("after", send_after(actor, message, 20000) == 0);
+
+    message.data = (void *) 1;
+    mu_assert("immediate", send_message(actor, message) == 0);
+    mu_assert("no such actor", send_after(actor + 1, message, 1000) == -2);
+
+    actor_system_join(actor);
+    mu_assert("not too early", arrived_at - sent_at >= 20000);
+    mu_assert("immediate first", immediate_at < arrived_at);
+    return 0;
+}
+
+// Timer due soon is not held back by a distant one already waiting.
+static char *not_late()
+{
+    actor_id_t actor;
+    arrived_at = 0;
+    mu_assert("create", actor_system_create(&actor, &role) == 0);
+
+    message_t message = {.message_type = MSG_MANY};
+    mu_assert("distant", send_after(actor, message, 10000000) == 0);
+    usleep(5000);
+
+    long sent_at = now_us();
+    message = (message_t) {.message_type = MSG_ARRIVE};
+    mu_assert("soon", send_after(actor, message, 1000) == 0);
+
+    actor_system_join(actor);
+    mu_assert("not too late", arrived_at - sent_at < 20000);
+    return 0;
+}
+
+// Periodic message stops when actor dies, so system can end.
+static char *periodic()
+{
+    actor_id_t actor;
+    ticks = 0;
+    mu_assert("create", actor_system_create(&actor, &role) == 0);
+
+    message_t message = {.message_type = MSG_TICK};
+    mu_assert("every", send_every(actor, message, 2000) == 0);
+
+    actor_system_join(actor);
+    mu_assert("ticked", ticks == TICKS);
+    return 0;
+}
+
+// Periodic message skips ticks while mailbox and parked list are full,
+// then keeps coming.
+static char *periodic_full()
+{
+    actor_id_t actor;
+    beats = 0;
+    held = false;
+    released = false;
+    cacti_config_t config = {
+            .threads = 2,
+            .mailbox_limit = 4,
+            .parked_limit = 1
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    message_t message = {.message_type = MSG_HOLD};
+    mu_assert("hold", send_message(actor, message) == 0);
+    while (!held) {
+    }
+
+    message = (message_t) {.message_type = MSG_BEAT};
+    for (int i = 0; i < 4; ++i) {
+        mu_assert("fits", send_message(actor, message) == 0);
+    }
+
+    // First tick is parked, following ones find no room.
+    mu_assert("every", send_every(actor, message, 1000) == 0);
+    while (send_failures() < 2) {
+    }
+    released = true;
+
+    while (beats < 7) {
+    }
+
+    mu_assert("godie", send_message(actor, (message_t) {
+            .message_type = MSG_GODIE}) == 0);
+    actor_system_join(actor);
+    return 0;
+}
+
+// Message without delay never waits for space, even from outside.
+static char *immediate_full()
+{
+    actor_id_t actor;
+    beats = 0;
+    held = false;
+    released = false;
+    cacti_config_t config = {
+            .threads = 2,
+            .mailbox_limit = 4,
+            .parked_limit = 1
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    message_t message = {.message_type = MSG_HOLD};
+    mu_assert("hold", send_message(actor, message) == 0);
+    while (!held) {
+    }
+
+    message = (message_t) {.message_type = MSG_BEAT};
+    for (int i = 0; i < 4; ++i) {
+        mu_assert("fits", send_after(actor, message, 0) == 0);
+    }
+    mu_assert("parked", send_after(actor, message, 0) == 0);
+    mu_assert("no room", send_after(actor, message, 0) == -1);
+    mu_assert("failure counted", send_failures() == 1);
+    released = true;
+
+    while (beats < 5) {
+    }
+
+    mu_assert("godie", send_message(actor, (message_t) {
+            .message_type = MSG_GODIE}) == 0);
+    actor_system_join(actor);
+    return 0;
+}
+
+static char *many_timers()
+{
+    actor_id_t actor;
+    many = 0;
+    mu_assert("create", actor_system_create(&actor, &role) == 0);
+
+    message_t message = {.message_type = MSG_MANY};
+    for (long i = 0; i < TIMERS; ++i) {
+        mu_assert("after", send_after(actor, message, (i * 7919) % 50000) == 0);
+    }
+
+    actor_system_join(actor);
+    mu_assert("all fired", many == TIMERS);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(delayed);
+    mu_run_test(not_late);
+    mu_run_test(periodic);
+    mu_run_test(periodic_full);
+    mu_run_test(immediate_full);
+    mu_run_test(many_timers);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
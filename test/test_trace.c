@@ -0,0 +1,94 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MSG_COUNT (message_type_t)0x1
+
+int tests_run = 0;
+
+static const message_t godie = {
+        .message_type = MSG_GODIE,
+        .nbytes = 0,
+        .data = NULL
+};
+
+static atomic_long counted;
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void count(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    counted += (long) data;
+}
+
+static role_t role = {
+        .nprompts = 2,
+        .prompts = (act_t[]) {hello, count}
+};
+
+// Events of finished system are written to trace file.
+static char *tracing()
+{
+    char path[] = "/tmp/cacti_traceXXXXXX";
+    int descriptor = mkstemp(path);
+    mu_assert("temporary file", descriptor != -1);
+    close(descriptor);
+
+    actor_id_t actor;
+    counted = 0;
+    cacti_config_t config = {
+            .threads = 2,
+            .trace_path = path
+    };
+    mu_assert("create", actor_system_create_ex(&actor, &role, &config) == 0);
+
+    message_t message = {.message_type = MSG_COUNT, .data = (void *) 1};
+    mu_assert("count", send_message(actor, message) == 0);
+    mu_assert("godie", send_message(actor, godie) == 0);
+    actor_system_join(actor);
+
+    char trace[65536];
+    FILE *file = fopen(path, "r");
+    size_t length = fread(trace, 1, sizeof(trace) - 1, file);
+    trace[length] = '\0';
+    fclose(file);
+    unlink(path);
+
+    mu_assert("chrome trace", strncmp(trace, "{\"traceEvents\":[", 16) == 0);
+    mu_assert("enqueue", strstr(trace, "\"name\":\"enqueue\"") != NULL);
+    mu_assert("handler", strstr(trace, "\"name\":\"handler\",\"ph\":\"B\"") != NULL);
+    mu_assert("godie", strstr(trace, "\"name\":\"godie\"") != NULL);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(tracing);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}